@@ -421,6 +421,7 @@ private:
 	~b2Body();
 
 	void SynchronizeFixtures();
+	void SynchronizeSpeculativeFixtures(float dt);
 	void SynchronizeTransform();
 
 	// This is used to prevent connected bodies from colliding.
@@ -27,6 +27,8 @@
 #include "b2_settings.h"
 #include "b2_collision.h"
 #include "b2_dynamic_tree.h"
+#include "b2_grid_hash.h"
+#include "b2_sweep_and_prune.h"
 
 struct B2_API b2Pair
 {
@@ -34,9 +36,27 @@ struct B2_API b2Pair
 	int32 proxyIdB;
 };
 
+/// The proxy structure used by the broad-phase.
+enum b2BroadPhaseType
+{
+	/// A dynamic AABB tree. This is the default and works well for most worlds.
+	b2_dynamicTreeBroadPhase = 0,
+
+	/// Sweep-and-prune along the x-axis. This suits worlds that are spread out
+	/// horizontally, such as side scrollers.
+	b2_sweepAndPruneBroadPhase,
+
+	/// A hashed uniform grid. This suits many objects of a similar size, such as
+	/// piles of circles. Set the cell size close to the typical object size.
+	b2_gridBroadPhase
+};
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+///
+/// The proxies are stored in one of several structures, chosen with SetType. Each structure
+/// provides the same CreateProxy/MoveProxy/Query/RayCast contract as b2DynamicTree.
 class B2_API b2BroadPhase
 {
 public:
@@ -49,6 +69,19 @@ public:
 	b2BroadPhase();
 	~b2BroadPhase();
 
+	/// Set the proxy structure. This must be called while there are no proxies.
+	void SetType(b2BroadPhaseType type);
+
+	/// Get the proxy structure.
+	b2BroadPhaseType GetType() const;
+
+	/// Set the cell size used by b2_gridBroadPhase. This must be called while
+	/// the grid has no proxies.
+	void SetGridCellSize(float cellSize);
+
+	/// Get the cell size used by b2_gridBroadPhase.
+	float GetGridCellSize() const;
+
 	/// Create a proxy with an initial AABB. Pairs are not reported until
 	/// UpdatePairs is called.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
@@ -63,6 +96,25 @@ public:
 	/// Call to trigger a re-processing of it's pairs on the next call to UpdatePairs.
 	void TouchProxy(int32 proxyId);
 
+	/// Set the category bits of a proxy for filtered queries. The dynamic tree uses
+	/// these to skip subtrees. The other structures ignore them.
+	void SetCategoryBits(int32 proxyId, uint16 categoryBits);
+
+	/// Set the collision layer of a proxy. Proxies start in layer 0.
+	void SetLayer(int32 proxyId, uint8 layer);
+
+	/// Enable or disable pairs between two layers. All layers collide by default.
+	void SetLayerCollision(int32 layerA, int32 layerB, bool flag);
+
+	/// Do proxies in these two layers form pairs?
+	bool GetLayerCollision(int32 layerA, int32 layerB) const;
+
+	/// Get the number of pairs rejected by the layer matrix since the last reset.
+	int32 GetRejectedPairCount() const;
+
+	/// Reset the rejected pair counter.
+	void ResetRejectedPairCount();
+
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
@@ -75,15 +127,40 @@ public:
 	/// Get the number of proxies.
 	int32 GetProxyCount() const;
 
+	/// Get the number of proxies created, moved, or touched since the last UpdatePairs.
+	int32 GetMoveCount() const;
+
+	/// Get a proxy from the move buffer. This is e_nullProxy if the proxy was destroyed.
+	int32 GetMoveProxy(int32 index) const;
+
 	/// Update the pairs. This results in pair callbacks. This can only add pairs.
 	template <typename T>
 	void UpdatePairs(T* callback);
 
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
+	/// The const queries keep their state on the stack, so they may run on several
+	/// threads at once. UpdatePairs and the proxy functions must not run concurrently.
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query an AABB, skipping proxies that have no category in maskBits where the
+	/// structure can do so cheaply. The callback must still apply its own filter.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb, uint16 maskBits) const;
+
+	/// Query many AABBs at once. The callback class is called with the query index
+	/// and proxy id for each overlap. Nearby AABBs should be adjacent in the array
+	/// so that the dynamic tree can share traversal between them.
+	template <typename T>
+	void QueryBatch(T* callback, const b2AABB* aabbs, int32 count) const;
+
+	/// Ray-cast many rays. The callback class is called with the ray index, the
+	/// clipped ray-cast input, and the proxy id. The dynamic tree traverses packets of
+	/// four rays, so neighboring rays should be coherent.
+	template <typename T>
+	void RayCastPacket(T* callback, const b2RayCastInput* inputs, int32 count) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -94,6 +171,24 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Ray-cast, skipping proxies that have no category in maskBits where the
+	/// structure can do so cheaply. The callback must still apply its own filter.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits) const;
+
+	/// Find the proxies nearest to a point. The callback class is called with the proxy
+	/// id and the current search radius and returns the new search radius, or a negative
+	/// value to terminate. The dynamic tree visits proxies in order of AABB distance and
+	/// skips subtrees beyond the search radius. The other structures query the AABB of
+	/// the initial search radius.
+	template <typename T>
+	void QueryNearest(T* callback, const b2Vec2& point, float maxDistance) const;
+
+	/// Find the nearest proxies, skipping proxies that have no category in maskBits where
+	/// the structure can do so cheaply. The callback must still apply its own filter.
+	template <typename T>
+	void QueryNearest(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits) const;
+
 	/// Get the height of the embedded tree.
 	int32 GetTreeHeight() const;
 
@@ -108,16 +203,34 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Reorder the proxy structure in memory for faster queries. This is useful
+	/// after many proxies have moved. Proxy ids are not changed.
+	void Relayout();
+
 private:
 
 	friend class b2DynamicTree;
+	friend class b2SweepAndPrune;
+	friend class b2GridHash;
+	template <typename T>
+	friend struct b2GridTreeWrapper;
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
 
 	bool QueryCallback(int32 proxyId);
+	void BufferPair(int32 proxyIdA, int32 proxyIdB);
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	uint8 GetLayer(int32 proxyId) const;
+
+	b2BroadPhaseType m_type;
 
 	b2DynamicTree m_tree;
+	b2SweepAndPrune m_sweepAndPrune;
+	b2GridHash m_grid;
 
 	int32 m_proxyCount;
 
@@ -130,23 +243,119 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+
+	// Indexed by proxy id. Ids past the capacity are in layer 0.
+	uint8* m_layers;
+	int32 m_layerCapacity;
+
+	uint64 m_layerMatrix[b2_maxLayers];
+	int32 m_rejectedPairCount;
 };
 
+inline b2BroadPhaseType b2BroadPhase::GetType() const
+{
+	return m_type;
+}
+
+inline void b2BroadPhase::SetGridCellSize(float cellSize)
+{
+	m_grid.SetCellSize(cellSize);
+}
+
+inline float b2BroadPhase::GetGridCellSize() const
+{
+	return m_grid.GetCellSize();
+}
+
+inline bool b2BroadPhase::GetLayerCollision(int32 layerA, int32 layerB) const
+{
+	b2Assert(0 <= layerA && layerA < b2_maxLayers);
+	b2Assert(0 <= layerB && layerB < b2_maxLayers);
+	return (m_layerMatrix[layerA] & (uint64(1) << layerB)) != 0;
+}
+
+inline int32 b2BroadPhase::GetRejectedPairCount() const
+{
+	return m_rejectedPairCount;
+}
+
+inline void b2BroadPhase::ResetRejectedPairCount()
+{
+	m_rejectedPairCount = 0;
+}
+
+inline uint8 b2BroadPhase::GetLayer(int32 proxyId) const
+{
+	return proxyId < m_layerCapacity ? m_layers[proxyId] : 0;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		return m_sweepAndPrune.GetUserData(proxyId);
+
+	case b2_gridBroadPhase:
+		return m_grid.GetUserData(proxyId);
+
+	default:
+		return m_tree.GetUserData(proxyId);
+	}
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		return m_sweepAndPrune.GetFatAABB(proxyId);
+
+	case b2_gridBroadPhase:
+		return m_grid.GetFatAABB(proxyId);
+
+	default:
+		return m_tree.GetFatAABB(proxyId);
+	}
+}
+
+inline bool b2BroadPhase::WasMoved(int32 proxyId) const
+{
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		return m_sweepAndPrune.WasMoved(proxyId);
+
+	case b2_gridBroadPhase:
+		return m_grid.WasMoved(proxyId);
+
+	default:
+		return m_tree.WasMoved(proxyId);
+	}
+}
+
+inline void b2BroadPhase::ClearMoved(int32 proxyId)
+{
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		m_sweepAndPrune.ClearMoved(proxyId);
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.ClearMoved(proxyId);
+		break;
+
+	default:
+		m_tree.ClearMoved(proxyId);
+	}
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -154,6 +363,17 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline int32 b2BroadPhase::GetMoveCount() const
+{
+	return m_moveCount;
+}
+
+inline int32 b2BroadPhase::GetMoveProxy(int32 index) const
+{
+	b2Assert(0 <= index && index < m_moveCount);
+	return m_moveBuffer[index];
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
 	return m_tree.GetHeight();
@@ -175,29 +395,48 @@ void b2BroadPhase::UpdatePairs(T* callback)
 	// Reset pair buffer
 	m_pairCount = 0;
 
-	// Perform tree queries for all moving proxies.
-	for (int32 i = 0; i < m_moveCount; ++i)
+	// Sweep-and-prune finds all pairs in one pass over the sorted axis. That beats a query
+	// per proxy once a good fraction of the proxies have moved.
+	if (m_type == b2_sweepAndPruneBroadPhase && 4 * m_moveCount > m_proxyCount)
 	{
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == e_nullProxy)
+		// Touched proxies must be reported as well.
+		for (int32 i = 0; i < m_moveCount; ++i)
 		{
-			continue;
+			int32 proxyId = m_moveBuffer[i];
+			if (proxyId != e_nullProxy)
+			{
+				m_sweepAndPrune.MarkMoved(proxyId);
+			}
 		}
 
-		// We have to query the tree with the fat AABB so that
-		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
-
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
+		m_sweepAndPrune.FindPairs(this);
+	}
+	else
+	{
+		// Perform queries for all moving proxies.
+		for (int32 i = 0; i < m_moveCount; ++i)
+		{
+			m_queryProxyId = m_moveBuffer[i];
+			if (m_queryProxyId == e_nullProxy)
+			{
+				continue;
+			}
+
+			// We have to query with the fat AABB so that
+			// we don't fail to create a pair that may touch later.
+			const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
+
+			// Query proxies, create pairs and add them pair buffer.
+			Query(this, fatAABB);
+		}
 	}
 
 	// Send pairs to caller
 	for (int32 i = 0; i < m_pairCount; ++i)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 	}
@@ -211,7 +450,7 @@ void b2BroadPhase::UpdatePairs(T* callback)
 			continue;
 		}
 
-		m_tree.ClearMoved(proxyId);
+		ClearMoved(proxyId);
 	}
 
 	// Reset move buffer
@@ -221,18 +460,179 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		m_sweepAndPrune.Query(callback, aabb);
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.Query(callback, aabb);
+		break;
+
+	default:
+		m_tree.Query(callback, aabb);
+	}
+}
+
+template <typename T>
+inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb, uint16 maskBits) const
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.Query(callback, aabb, maskBits);
+		return;
+	}
+
+	Query(callback, aabb);
+}
+
+// Forwards single query callbacks to a batch query callback.
+template <typename T>
+struct b2BatchQueryWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		callback->QueryCallback(queryIndex, proxyId);
+		return true;
+	}
+
+	T* callback;
+	int32 queryIndex;
+};
+
+template <typename T>
+inline void b2BroadPhase::QueryBatch(T* callback, const b2AABB* aabbs, int32 count) const
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.QueryBatch(callback, aabbs, count);
+		return;
+	}
+
+	// The other structures have cheap queries that do not share work.
+	b2BatchQueryWrapper<T> wrapper;
+	wrapper.callback = callback;
+	for (int32 i = 0; i < count; ++i)
+	{
+		wrapper.queryIndex = i;
+		Query(&wrapper, aabbs[i]);
+	}
+}
+
+// Forwards single ray-cast callbacks to a packet ray-cast callback.
+template <typename T>
+struct b2PacketRayCastWrapper
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		return callback->RayCastCallback(rayIndex, input, proxyId);
+	}
+
+	T* callback;
+	int32 rayIndex;
+};
+
+template <typename T>
+inline void b2BroadPhase::RayCastPacket(T* callback, const b2RayCastInput* inputs, int32 count) const
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.RayCastPacket(callback, inputs, count);
+		return;
+	}
+
+	b2PacketRayCastWrapper<T> wrapper;
+	wrapper.callback = callback;
+	for (int32 i = 0; i < count; ++i)
+	{
+		wrapper.rayIndex = i;
+		RayCast(&wrapper, inputs[i]);
+	}
+}
+
+// Forwards AABB query callbacks to a nearest query callback.
+template <typename T>
+struct b2NearestQueryWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		if (b2DistanceSquared(broadPhase->GetFatAABB(proxyId), point) > maxDistance * maxDistance)
+		{
+			return true;
+		}
+
+		maxDistance = callback->QueryNearestCallback(proxyId, maxDistance);
+		return maxDistance >= 0.0f;
+	}
+
+	const b2BroadPhase* broadPhase;
+	T* callback;
+	b2Vec2 point;
+	float maxDistance;
+};
+
+template <typename T>
+inline void b2BroadPhase::QueryNearest(T* callback, const b2Vec2& point, float maxDistance) const
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.QueryNearest(callback, point, maxDistance);
+		return;
+	}
+
+	b2NearestQueryWrapper<T> wrapper;
+	wrapper.broadPhase = this;
+	wrapper.callback = callback;
+	wrapper.point = point;
+	wrapper.maxDistance = maxDistance;
+
+	b2AABB aabb;
+	aabb.lowerBound = point - b2Vec2(maxDistance, maxDistance);
+	aabb.upperBound = point + b2Vec2(maxDistance, maxDistance);
+	Query(&wrapper, aabb);
+}
+
+template <typename T>
+inline void b2BroadPhase::QueryNearest(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits) const
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.QueryNearest(callback, point, maxDistance, maskBits);
+		return;
+	}
+
+	QueryNearest(callback, point, maxDistance);
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		m_sweepAndPrune.RayCast(callback, input);
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.RayCast(callback, input);
+		break;
+
+	default:
+		m_tree.RayCast(callback, input);
+	}
 }
 
-inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
+template <typename T>
+inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits) const
 {
-	m_tree.ShiftOrigin(newOrigin);
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.RayCast(callback, input, maskBits);
+		return;
+	}
+
+	RayCast(callback, input);
 }
 
 #endif
@@ -38,7 +38,7 @@ class B2_API b2ChainShape : public b2Shape
 public:
 	b2ChainShape();
 
-	/// The destructor frees the vertices using b2Free.
+	/// The destructor frees the vertices and normals using b2Free.
 	~b2ChainShape();
 
 	/// Clear all data.
@@ -88,6 +88,11 @@ public:
 	int32 m_count;
 
 	b2Vec2 m_prevVertex, m_nextVertex;
+
+	/// Unit normals of the segments, including the ghost segments at both ends, so
+	/// there are m_count + 1. Child edge i uses m_normals[i] to m_normals[i + 2].
+	/// Owned by this class.
+	b2Vec2* m_normals;
 };
 
 inline b2ChainShape::b2ChainShape()
@@ -96,6 +101,7 @@ inline b2ChainShape::b2ChainShape()
 	m_radius = b2_polygonRadius;
 	m_vertices = nullptr;
 	m_count = 0;
+	m_normals = nullptr;
 }
 
 #endif
@@ -33,9 +33,12 @@
 /// queries, and TOI queries.
 
 class b2Shape;
+class b2CapsuleShape;
+class b2ChainShape;
 class b2CircleShape;
 class b2EdgeShape;
 class b2PolygonShape;
+struct b2SimplexCache;
 
 const uint8 b2_nullFeature = UCHAR_MAX;
 
@@ -231,11 +234,32 @@ B2_API void b2CollidePolygonAndCircle(b2Manifold* manifold,
 							   const b2PolygonShape* polygonA, const b2Transform& xfA,
 							   const b2CircleShape* circleB, const b2Transform& xfB);
 
+/// Use the SIMD polygon and edge colliders if the build supports it. This is on by default. The
+/// scalar colliders produce the same manifolds and are kept for testing.
+extern B2_API bool b2_simdCollision;
+
+/// Use the box colliders for polygons made by b2PolygonShape::SetAsBox. This is on by
+/// default. Turn it off to compare with the general polygon collider.
+extern B2_API bool b2_boxCollision;
+
+/// Use the hill climbing collider for polygons with more than b2_hillClimbVertexCount
+/// vertices. This is on by default. Turn it off to compare with the general polygon collider.
+extern B2_API bool b2_hillClimbCollision;
+
 /// Compute the collision manifold between two polygons.
 B2_API void b2CollidePolygons(b2Manifold* manifold,
 					   const b2PolygonShape* polygonA, const b2Transform& xfA,
 					   const b2PolygonShape* polygonB, const b2Transform& xfB);
 
+typedef void b2CollidePolygonsFcn(b2Manifold* manifold,
+								  const b2PolygonShape* polygonA, const b2Transform& xfA,
+								  const b2PolygonShape* polygonB, const b2Transform& xfB);
+
+/// Get a polygon collider specialized for the given vertex counts. Triangles, quads and
+/// octagons have unrolled colliders, other counts get b2CollidePolygons. The returned
+/// collider must only be used with polygons that have these vertex counts.
+B2_API b2CollidePolygonsFcn* b2GetPolygonCollider(int32 countA, int32 countB);
+
 /// Compute the collision manifold between an edge and a circle.
 B2_API void b2CollideEdgeAndCircle(b2Manifold* manifold,
 							   const b2EdgeShape* polygonA, const b2Transform& xfA,
@@ -246,15 +270,49 @@ B2_API void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 							   const b2EdgeShape* edgeA, const b2Transform& xfA,
 							   const b2PolygonShape* circleB, const b2Transform& xfB);
 
+/// Compute the collision manifold between a chain segment and a polygon. This gives the
+/// same result as b2CollideEdgeAndPolygon with b2ChainShape::GetChildEdge, but uses the
+/// segment normals stored in the chain.
+B2_API void b2CollideChainAndPolygon(b2Manifold* manifold,
+							   const b2ChainShape* chainA, int32 indexA, const b2Transform& xfA,
+							   const b2PolygonShape* polygonB, const b2Transform& xfB);
+
+/// Compute the collision manifold between a capsule and a circle.
+B2_API void b2CollideCapsuleAndCircle(b2Manifold* manifold,
+							   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+							   const b2CircleShape* circleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between two capsules.
+B2_API void b2CollideCapsules(b2Manifold* manifold,
+					   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+					   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between a polygon and a capsule.
+B2_API void b2CollidePolygonAndCapsule(b2Manifold* manifold,
+							   const b2PolygonShape* polygonA, const b2Transform& xfA,
+							   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between an edge and a capsule.
+B2_API void b2CollideEdgeAndCapsule(b2Manifold* manifold,
+							   const b2EdgeShape* edgeA, const b2Transform& xfA,
+							   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
 /// Clipping for contact manifolds.
 B2_API int32 b2ClipSegmentToLine(b2ClipVertex vOut[2], const b2ClipVertex vIn[2],
 							const b2Vec2& normal, float offset, int32 vertexIndexA);
 
-/// Determine if two generic shapes overlap.
+/// Determine if two generic shapes overlap. This is safe to call from several threads.
 B2_API bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB);
 
+/// Determine if two generic shapes overlap. The cache warm starts GJK with the simplex
+/// of the previous call on the same pair of shapes. Set cache->count to zero on first use.
+B2_API bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
+					const b2Shape* shapeB, int32 indexB,
+					const b2Transform& xfA, const b2Transform& xfB,
+					b2SimplexCache* cache);
+
 // ---------------- Inline Functions ------------------------------------------
 
 inline bool b2AABB::IsValid() const
@@ -33,6 +33,11 @@
 	#define b2DEBUG
 #endif
 
+// SSE2 is available on every x64 processor. Define B2_NO_SIMD to use scalar code only.
+#if !defined(B2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define B2_SSE2
+#endif
+
 #define B2_NOT_USED(x) ((void)(x))
 #define b2Assert(A) assert(A)
 
@@ -60,6 +65,14 @@
 /// This is a dimensionless multiplier.
 #define b2_aabbMultiplier		4.0f
 
+/// The default cell size of the grid broad-phase. Proxies up to about this
+/// size are stored in the grid and larger ones in a tree. In meters.
+#define b2_gridCellSize			(2.0f * b2_lengthUnitsPerMeter)
+
+/// The number of collision layers. Each layer has one bit per layer in the
+/// layer collision matrix. Do not change this value.
+#define b2_maxLayers			64
+
 /// A small length used as a collision and constraint tolerance. Usually it is
 /// chosen to be numerically significant, but visually insignificant. In meters.
 #define b2_linearSlop			(0.005f * b2_lengthUnitsPerMeter)
@@ -73,9 +86,26 @@
 /// Making it larger may create artifacts for vertex collision.
 #define b2_polygonRadius		(2.0f * b2_linearSlop)
 
+/// Polygons with more vertices than this find support points by hill climbing over
+/// neighboring vertices instead of testing every vertex.
+#define b2_hillClimbVertexCount		8
+
 /// Maximum number of sub-steps per contact in continuous physics simulation.
 #define b2_maxSubSteps			8
 
+/// A contact can keep its manifold while the relative pose of the two bodies stays
+/// within these tolerances of the pose used to compute it. See b2World::SetManifoldReuse.
+#define b2_manifoldLinearTolerance		(0.1f * b2_linearSlop)
+#define b2_manifoldAngularTolerance		(0.05f * b2_angularSlop)
+
+/// A speculative contact point is added when two separated shapes are closing fast enough
+/// to meet within the time step, plus this distance.
+#define b2_speculativeDistance		(4.0f * b2_linearSlop)
+
+/// The narrow phase gathers this many contacts and then evaluates them grouped by
+/// shape pair type. Small enough that the gathered contacts stay in cache.
+#define b2_contactBatchSize		256
+
 
 // Dynamics
 
@@ -25,6 +25,7 @@
 
 #include "b2_api.h"
 #include "b2_collision.h"
+#include "b2_distance.h"
 #include "b2_fixture.h"
 #include "b2_math.h"
 #include "b2_shape.h"
@@ -62,10 +63,18 @@ typedef b2Contact* b2ContactCreateFcn(	b2Fixture* fixtureA, int32 indexA,
 										b2BlockAllocator* allocator);
 typedef void b2ContactDestroyFcn(b2Contact* contact, b2BlockAllocator* allocator);
 
+/// Updates a batch of contacts that all have the same shape types. The transforms are
+/// arrays parallel to the contacts and the indices select the batch. A positive speculative
+/// time adds speculative points, see b2World::SetSpeculativeContacts.
+typedef void b2ContactUpdateFcn(b2Contact** contacts, const b2Transform* xfAs, const b2Transform* xfBs,
+								const int32* indices, int32 count, b2ContactListener* listener,
+								float speculativeTime);
+
 struct B2_API b2ContactRegister
 {
 	b2ContactCreateFcn* createFcn;
 	b2ContactDestroyFcn* destroyFcn;
+	b2ContactUpdateFcn* updateFcn;
 	bool primary;
 };
 
@@ -97,6 +106,10 @@ public:
 	/// Get the world manifold.
 	void GetWorldManifold(b2WorldManifold* worldManifold) const;
 
+	/// Get the simplex cache used to warm start the distance queries of this contact.
+	/// It is reset when the contact is refiltered.
+	const b2SimplexCache* GetSimplexCache() const;
+
 	/// Is this contact touching?
 	bool IsTouching() const;
 
@@ -191,14 +204,17 @@ protected:
 		e_bulletHitFlag		= 0x0010,
 
 		// This contact has a valid TOI in m_toi
-		e_toiFlag			= 0x0020
+		e_toiFlag			= 0x0020,
+
+		// The manifold was computed at the relative pose in m_manifoldXf
+		e_manifoldPoseFlag	= 0x0040
 	};
 
 	/// Flag this contact for filtering. Filtering will occur the next time step.
 	void FlagForFiltering();
 
 	static void AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* destroyFcn,
-						b2Shape::Type typeA, b2Shape::Type typeB);
+						b2ContactUpdateFcn* updateFcn, b2Shape::Type typeA, b2Shape::Type typeB);
 	static void InitializeRegisters();
 	static b2Contact* Create(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB, b2BlockAllocator* allocator);
 	static void Destroy(b2Contact* contact, b2Shape::Type typeA, b2Shape::Type typeB, b2BlockAllocator* allocator);
@@ -208,7 +224,26 @@ protected:
 	b2Contact(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB);
 	virtual ~b2Contact() {}
 
-	void Update(b2ContactListener* listener);
+	// Returns true if the manifold was reused instead of evaluated.
+	bool Update(b2ContactListener* listener, bool allowReuse);
+
+	// The batched narrow phase splits Update in two. NeedsEvaluate is false for sensors
+	// and for manifolds that can be reused. Empty manifolds are never reused with
+	// speculative contacts, since the closing velocity may have changed. Finish takes the
+	// new manifold, or nullptr if NeedsEvaluate was false.
+	bool NeedsEvaluate(bool allowReuse, bool speculative) const;
+	void Finish(b2ContactListener* listener, const b2Manifold* manifold);
+
+	// Updates a batch of contacts of the concrete type T. See b2ContactUpdateFcn.
+	template <typename T>
+	static void UpdateBatch(b2Contact** contacts, const b2Transform* xfAs, const b2Transform* xfBs,
+							const int32* indices, int32 count, b2ContactListener* listener,
+							float speculativeTime);
+
+	// Fills an empty manifold with speculative points if the shapes are apart but closing
+	// fast enough to meet within the time step.
+	void EvaluateSpeculative(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB,
+							 float timeStep);
 
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
@@ -231,6 +266,12 @@ protected:
 
 	b2Manifold m_manifold;
 
+	// Pose of body B relative to body A when the manifold was last evaluated.
+	b2Transform m_manifoldXf;
+
+	// GJK simplex of the last overlap test, used to warm start sensors and speculative points.
+	b2SimplexCache m_simplexCache;
+
 	int32 m_toiCount;
 	float m_toi;
 
@@ -251,6 +292,11 @@ inline const b2Manifold* b2Contact::GetManifold() const
 	return &m_manifold;
 }
 
+inline const b2SimplexCache* b2Contact::GetSimplexCache() const
+{
+	return &m_simplexCache;
+}
+
 inline void b2Contact::GetWorldManifold(b2WorldManifold* worldManifold) const
 {
 	const b2Body* bodyA = m_fixtureA->GetBody();
@@ -46,12 +46,31 @@ public:
 
 	void Collide();
 
+	// Evaluates and finishes the gathered contacts.
+	void UpdateBatch();
+
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
 	int32 m_contactCount;
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+
+	// Manifold reuse for contacts that barely moved, and how often it happened in Collide.
+	bool m_manifoldReuse;
+	int32 m_reusedManifoldCount;
+
+	// Time step used to predict speculative contacts. Zero disables them.
+	float m_speculativeTime;
+
+	// Contacts gathered for the narrow phase and their transforms. m_batchOrder groups
+	// them by shape pair type.
+	b2Contact* m_batchContacts[b2_contactBatchSize];
+	int32 m_batchTypes[b2_contactBatchSize];
+	int32 m_batchOrder[b2_contactBatchSize];
+	b2Transform m_batchXfAs[b2_contactBatchSize];
+	b2Transform m_batchXfBs[b2_contactBatchSize];
+	int32 m_batchCount;
 };
 
 #endif
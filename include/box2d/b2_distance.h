@@ -24,6 +24,7 @@
 #define B2_DISTANCE_H
 
 #include "b2_api.h"
+#include "b2_common.h"
 #include "b2_math.h"
 
 class b2Shape;
@@ -32,7 +33,7 @@ class b2Shape;
 /// It encapsulates any shape.
 struct B2_API b2DistanceProxy
 {
-	b2DistanceProxy() : m_vertices(nullptr), m_count(0), m_radius(0.0f) {}
+	b2DistanceProxy() : m_vertices(nullptr), m_count(0), m_radius(0.0f), m_convex(false) {}
 
 	/// Initialize the proxy using the given shape. The shape
 	/// must remain in scope while the proxy is in use.
@@ -42,9 +43,19 @@ struct B2_API b2DistanceProxy
     /// must remain in scope while the proxy is in use.
     void Set(const b2Vec2* vertices, int32 count, float radius);
 
+	/// Initialize the proxy using a convex polygon with counter-clockwise vertices.
+	/// Neighboring vertices are adjacent, so support queries on large polygons can
+	/// hill climb instead of testing every vertex.
+	void SetConvex(const b2Vec2* vertices, int32 count, float radius);
+
 	/// Get the supporting vertex index in the given direction.
 	int32 GetSupport(const b2Vec2& d) const;
 
+	/// Get the supporting vertex index in the given direction. Convex proxies with more
+	/// than b2_hillClimbVertexCount vertices start the search at the given vertex, so a
+	/// nearby guess such as the previous support vertex makes the query cheap.
+	int32 GetSupport(const b2Vec2& d, int32 start) const;
+
 	/// Get the supporting vertex in the given direction.
 	const b2Vec2& GetSupportVertex(const b2Vec2& d) const;
 
@@ -58,6 +69,12 @@ struct B2_API b2DistanceProxy
 	const b2Vec2* m_vertices;
 	int32 m_count;
 	float m_radius;
+
+	/// True if the vertices form a convex polygon in counter-clockwise order.
+	bool m_convex;
+
+private:
+	int32 ClimbSupport(const b2Vec2& d, int32 start) const;
 };
 
 /// Used to warm start b2Distance.
@@ -136,6 +153,16 @@ inline const b2Vec2& b2DistanceProxy::GetVertex(int32 index) const
 
 inline int32 b2DistanceProxy::GetSupport(const b2Vec2& d) const
 {
+	return GetSupport(d, 0);
+}
+
+inline int32 b2DistanceProxy::GetSupport(const b2Vec2& d, int32 start) const
+{
+	if (m_convex && m_count > b2_hillClimbVertexCount)
+	{
+		return ClimbSupport(d, start);
+	}
+
 	int32 bestIndex = 0;
 	float bestValue = b2Dot(m_vertices[0], d);
 	for (int32 i = 1; i < m_count; ++i)
@@ -153,19 +180,7 @@ inline int32 b2DistanceProxy::GetSupport(const b2Vec2& d) const
 
 inline const b2Vec2& b2DistanceProxy::GetSupportVertex(const b2Vec2& d) const
 {
-	int32 bestIndex = 0;
-	float bestValue = b2Dot(m_vertices[0], d);
-	for (int32 i = 1; i < m_count; ++i)
-	{
-		float value = b2Dot(m_vertices[i], d);
-		if (value > bestValue)
-		{
-			bestIndex = i;
-			bestValue = value;
-		}
-	}
-
-	return m_vertices[bestIndex];
+	return m_vertices[GetSupport(d)];
 }
 
 #endif
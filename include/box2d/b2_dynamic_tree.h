@@ -25,11 +25,101 @@
 
 #include "b2_api.h"
 #include "b2_collision.h"
-#include "b2_growable_stack.h"
+
+#if defined(B2_SSE2)
+#include <emmintrin.h>
+#endif
 
 #define b2_nullNode (-1)
 
+/// Compute the enlarged AABB that a broad-phase stores for a proxy. The AABB is
+/// extended by b2_aabbExtension and predictively stretched along the displacement.
+inline b2AABB b2ComputeFatAABB(const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2AABB fatAABB;
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	fatAABB.lowerBound = aabb.lowerBound - r;
+	fatAABB.upperBound = aabb.upperBound + r;
+
+	// Predict AABB movement
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		fatAABB.lowerBound.x += d.x;
+	}
+	else
+	{
+		fatAABB.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		fatAABB.lowerBound.y += d.y;
+	}
+	else
+	{
+		fatAABB.upperBound.y += d.y;
+	}
+
+	return fatAABB;
+}
+
+/// Get the squared distance from a point to an AABB. This is zero if the point is inside.
+inline float b2DistanceSquared(const b2AABB& aabb, const b2Vec2& point)
+{
+	float dx = b2Max(b2Max(aabb.lowerBound.x - point.x, point.x - aabb.upperBound.x), 0.0f);
+	float dy = b2Max(b2Max(aabb.lowerBound.y - point.y, point.y - aabb.upperBound.y), 0.0f);
+	return dx * dx + dy * dy;
+}
+
+/// Determine if a stored fat AABB must be replaced. This is true if the stored AABB no longer
+/// contains the object or if it is much larger than the new fat AABB. The latter happens when
+/// an object was moving fast but has since gone to sleep.
+inline bool b2NeedsFatAABBUpdate(const b2AABB& storedAABB, const b2AABB& aabb, const b2AABB& fatAABB)
+{
+	if (storedAABB.Contains(aabb))
+	{
+		// The huge AABB is larger than the new fat AABB.
+		b2Vec2 r(4.0f * b2_aabbExtension, 4.0f * b2_aabbExtension);
+		b2AABB hugeAABB;
+		hugeAABB.lowerBound = fatAABB.lowerBound - r;
+		hugeAABB.upperBound = fatAABB.upperBound + r;
+
+		if (hugeAABB.Contains(storedAABB))
+		{
+			// The stored AABB contains the object AABB and is not too large.
+			return false;
+		}
+
+		// Otherwise the stored AABB is huge and needs to be shrunk
+	}
+
+	return true;
+}
+
+/// Four rays prepared for slab tests against AABBs. The rays are parameterized by
+/// fraction, so a ray hits an AABB if the slabs overlap within [0, maxFraction].
+/// An unused or finished lane has a negative max fraction.
+struct B2_API b2RayPacket
+{
+	/// Set up to four rays. The remaining lanes are disabled.
+	void Set(const b2RayCastInput* inputs, int32 count);
+
+	/// Get a 4-bit mask of the rays that hit the AABB.
+	uint32 TestAABB(const b2AABB& aabb) const;
+
+	float originX[4];
+	float originY[4];
+	float inverseX[4];
+	float inverseY[4];
+	float maxFraction[4];
+};
+
 /// A node in the dynamic tree. The client does not interact with this directly.
+/// A node only holds what traversal and balancing touch, so it is 32 bytes and
+/// two nodes share a cache line. The tree keeps user data and the moved flag in
+/// separate arrays indexed by proxy id.
 struct B2_API b2TreeNode
 {
 	bool IsLeaf() const
@@ -40,8 +130,6 @@ struct B2_API b2TreeNode
 	/// Enlarged AABB
 	b2AABB aabb;
 
-	void* userData;
-
 	union
 	{
 		int32 parent;
@@ -49,12 +137,20 @@ struct B2_API b2TreeNode
 	};
 
 	int32 child1;
-	int32 child2;
+
+	union
+	{
+		int32 child2;
+
+		// Leaf nodes store their proxy id here.
+		int32 proxyId;
+	};
 
 	// leaf = 0, free node = -1
-	int32 height;
+	int16 height;
 
-	bool moved;
+	// The union of the category bits in this subtree
+	uint16 categoryBits;
 };
 
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
@@ -65,6 +161,10 @@ struct B2_API b2TreeNode
 /// object to move by small amounts without triggering a tree update.
 ///
 /// Nodes are pooled and relocatable, so we use node indices rather than pointers.
+/// Proxy ids are stable handles that map to leaf nodes, which lets Relayout
+/// reorder the node pool.
+/// Queries and ray casts walk the tree using parent links instead of a stack,
+/// so they never allocate, however deep the tree is.
 class B2_API b2DynamicTree
 {
 public:
@@ -93,6 +193,13 @@ public:
 	bool WasMoved(int32 proxyId) const;
 	void ClearMoved(int32 proxyId);
 
+	/// Set the category bits of a proxy. New proxies have all category bits set.
+	/// Filtered queries skip subtrees that have no category in the query mask.
+	void SetCategoryBits(int32 proxyId, uint16 categoryBits);
+
+	/// Get the category bits of a proxy.
+	uint16 GetCategoryBits(int32 proxyId) const;
+
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
@@ -101,6 +208,24 @@ public:
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query an AABB for overlapping proxies that have a category in maskBits.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb, uint16 maskBits) const;
+
+	/// Query many AABBs in one pass. The AABBs are processed in packets of 32 that
+	/// share the tree traversal, so nearby AABBs should be adjacent in the array.
+	/// The callback class is called with the query index and proxy id for each overlap.
+	template <typename T>
+	void QueryBatch(T* callback, const b2AABB* aabbs, int32 count) const;
+
+	/// Ray-cast many rays against the proxies in the tree. Rays are traversed in packets
+	/// of four using b2RayPacket slab tests, so neighboring rays should be coherent.
+	/// The callback class is called with the ray index, the ray-cast input clipped to
+	/// that ray's current fraction, and the proxy id. The callback return value
+	/// controls each ray the same way as in RayCast.
+	template <typename T>
+	void RayCastPacket(T* callback, const b2RayCastInput* inputs, int32 count) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -111,6 +236,24 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Ray-cast against the proxies that have a category in maskBits.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits) const;
+
+	/// Find the proxies nearest to a point. This is a branch and bound traversal that
+	/// visits the child with the nearer AABB first and skips subtrees farther than the
+	/// current search radius. The callback class is called with the proxy id and the
+	/// current search radius and returns the new search radius, such as the distance
+	/// to the k-th nearest proxy found so far. Return a negative value to terminate.
+	/// @param point the query point.
+	/// @param maxDistance the initial search radius.
+	template <typename T>
+	void QueryNearest(T* callback, const b2Vec2& point, float maxDistance) const;
+
+	/// Find the nearest proxies that have a category in maskBits.
+	template <typename T>
+	void QueryNearest(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits) const;
+
 	/// Validate this tree. For testing.
 	void Validate() const;
 
@@ -128,6 +271,11 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Reorder the node pool so that nodes are stored in depth-first order. Incremental
+	/// updates scatter the nodes over time, so calling this occasionally improves the
+	/// cache behavior of queries. This is linear in the node count and keeps proxy ids.
+	void Relayout();
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -138,6 +286,18 @@ private:
 	int32 AllocateNode();
 	void FreeNode(int32 node);
 
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	template <typename T>
+	void QueryNodes(T* callback, const b2AABB& aabb, uint16 maskBits, bool filter) const;
+
+	template <typename T>
+	void RayCastNodes(T* callback, const b2RayCastInput& input, uint16 maskBits, bool filter) const;
+
+	template <typename T>
+	void QueryNearestNodes(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits, bool filter) const;
+
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
@@ -157,70 +317,448 @@ private:
 
 	int32 m_freeList;
 
+	// Indexed by proxy id. Free proxies link through m_proxyNodes.
+	int32* m_proxyNodes;
+	void** m_userData;
+	bool* m_moved;
+	int32 m_proxyCapacity;
+	int32 m_proxyFreeList;
+
 	int32 m_insertionCount;
 };
 
+inline void b2RayPacket::Set(const b2RayCastInput* inputs, int32 count)
+{
+	b2Assert(0 < count && count <= 4);
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if (i >= count)
+		{
+			originX[i] = 0.0f;
+			originY[i] = 0.0f;
+			inverseX[i] = 0.0f;
+			inverseY[i] = 0.0f;
+			maxFraction[i] = -1.0f;
+			continue;
+		}
+
+		// A zero direction gives an unbounded slab without generating NaNs.
+		b2Vec2 d = inputs[i].p2 - inputs[i].p1;
+		originX[i] = inputs[i].p1.x;
+		originY[i] = inputs[i].p1.y;
+		inverseX[i] = d.x != 0.0f ? 1.0f / d.x : b2_maxFloat;
+		inverseY[i] = d.y != 0.0f ? 1.0f / d.y : b2_maxFloat;
+		maxFraction[i] = inputs[i].maxFraction;
+	}
+}
+
+inline uint32 b2RayPacket::TestAABB(const b2AABB& aabb) const
+{
+#if defined(B2_SSE2)
+	__m128 ox = _mm_loadu_ps(originX);
+	__m128 oy = _mm_loadu_ps(originY);
+	__m128 ix = _mm_loadu_ps(inverseX);
+	__m128 iy = _mm_loadu_ps(inverseY);
+
+	__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.lowerBound.x), ox), ix);
+	__m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.upperBound.x), ox), ix);
+	__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.lowerBound.y), oy), iy);
+	__m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.upperBound.y), oy), iy);
+
+	__m128 tMin = _mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2));
+	__m128 tMax = _mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2));
+
+	tMin = _mm_max_ps(tMin, _mm_setzero_ps());
+	tMax = _mm_min_ps(tMax, _mm_loadu_ps(maxFraction));
+
+	return uint32(_mm_movemask_ps(_mm_cmple_ps(tMin, tMax)));
+#else
+	uint32 mask = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		float tx1 = (aabb.lowerBound.x - originX[i]) * inverseX[i];
+		float tx2 = (aabb.upperBound.x - originX[i]) * inverseX[i];
+		float ty1 = (aabb.lowerBound.y - originY[i]) * inverseY[i];
+		float ty2 = (aabb.upperBound.y - originY[i]) * inverseY[i];
+
+		float tMin = b2Max(b2Max(b2Min(tx1, tx2), b2Min(ty1, ty2)), 0.0f);
+		float tMax = b2Min(b2Min(b2Max(tx1, tx2), b2Max(ty1, ty2)), maxFraction[i]);
+
+		if (tMin <= tMax)
+		{
+			mask |= 1u << i;
+		}
+	}
+
+	return mask;
+#endif
+}
+
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	return m_nodes[proxyId].userData;
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_userData[proxyId];
 }
 
 inline bool b2DynamicTree::WasMoved(int32 proxyId) const
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	return m_nodes[proxyId].moved;
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_moved[proxyId];
 }
 
 inline void b2DynamicTree::ClearMoved(int32 proxyId)
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	m_nodes[proxyId].moved = false;
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_moved[proxyId] = false;
+}
+
+inline uint16 b2DynamicTree::GetCategoryBits(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_nodes[m_proxyNodes[proxyId]].categoryBits;
 }
 
 inline const b2AABB& b2DynamicTree::GetFatAABB(int32 proxyId) const
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	return m_nodes[proxyId].aabb;
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_nodes[m_proxyNodes[proxyId]].aabb;
 }
 
 template <typename T>
 inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 {
-	b2GrowableStack<int32, 256> stack;
-	stack.Push(m_root);
+	// Proxies may have no category bits, so an unfiltered query must not prune.
+	QueryNodes(callback, aabb, 0xFFFF, false);
+}
+
+template <typename T>
+inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb, uint16 maskBits) const
+{
+	QueryNodes(callback, aabb, maskBits, true);
+}
+
+template <typename T>
+inline void b2DynamicTree::QueryNodes(T* callback, const b2AABB& aabb, uint16 maskBits, bool filter) const
+{
+	// Stackless traversal. The previous node tells us whether we arrived
+	// from the parent, the first child, or the second child.
+	int32 previousId = b2_nullNode;
+	int32 nodeId = m_root;
 
-	while (stack.GetCount() > 0)
+	while (nodeId != b2_nullNode)
 	{
-		int32 nodeId = stack.Pop();
-		if (nodeId == b2_nullNode)
+		const b2TreeNode* node = m_nodes + nodeId;
+		int32 nextId;
+
+		if (previousId == node->parent)
 		{
-			continue;
+			if (filter && (node->categoryBits & maskBits) == 0)
+			{
+				nextId = node->parent;
+			}
+			else if (b2TestOverlap(node->aabb, aabb) == false)
+			{
+				nextId = node->parent;
+			}
+			else if (node->IsLeaf())
+			{
+				bool proceed = callback->QueryCallback(node->proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+
+				nextId = node->parent;
+			}
+			else
+			{
+				nextId = node->child1;
+			}
+		}
+		else if (previousId == node->child1)
+		{
+			nextId = node->child2;
+		}
+		else
+		{
+			nextId = node->parent;
+		}
+
+		previousId = nodeId;
+		nodeId = nextId;
+	}
+}
+
+template <typename T>
+inline void b2DynamicTree::QueryBatch(T* callback, const b2AABB* aabbs, int32 count) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	const int32 packetSize = 32;
+
+	// Packet masks of the nodes on the current path, indexed by depth. Deeper nodes
+	// reuse the mask of their deepest cached ancestor, which is a superset.
+	const int32 maskDepth = 32;
+	uint32 masks[maskDepth];
+
+	for (int32 base = 0; base < count; base += packetSize)
+	{
+		const b2AABB* packet = aabbs + base;
+		int32 packetCount = b2Min(packetSize, count - base);
+		uint32 fullMask = packetCount == 32 ? 0xFFFFFFFF : (1u << packetCount) - 1;
+
+		int32 previousId = b2_nullNode;
+		int32 nodeId = m_root;
+		int32 depth = 0;
+
+		while (nodeId != b2_nullNode)
+		{
+			const b2TreeNode* node = m_nodes + nodeId;
+			int32 nextId;
+
+			if (previousId == node->parent)
+			{
+				uint32 parentMask = depth == 0 ? fullMask : masks[b2Min(depth, maskDepth) - 1];
+
+				// Narrow the packet to the queries that overlap this node.
+				uint32 mask = 0;
+				for (int32 i = 0; i < packetCount; ++i)
+				{
+					if ((parentMask & (1u << i)) && b2TestOverlap(node->aabb, packet[i]))
+					{
+						mask |= 1u << i;
+					}
+				}
+
+				if (mask == 0)
+				{
+					nextId = node->parent;
+				}
+				else if (node->IsLeaf())
+				{
+					for (int32 i = 0; i < packetCount; ++i)
+					{
+						if (mask & (1u << i))
+						{
+							callback->QueryCallback(base + i, node->proxyId);
+						}
+					}
+
+					nextId = node->parent;
+				}
+				else
+				{
+					if (depth < maskDepth)
+					{
+						masks[depth] = mask;
+					}
+
+					nextId = node->child1;
+				}
+			}
+			else if (previousId == node->child1)
+			{
+				nextId = node->child2;
+			}
+			else
+			{
+				nextId = node->parent;
+			}
+
+			// Track the depth of the next node.
+			if (nextId == node->parent)
+			{
+				--depth;
+			}
+			else
+			{
+				++depth;
+			}
+
+			previousId = nodeId;
+			nodeId = nextId;
 		}
+	}
+}
+
+template <typename T>
+inline void b2DynamicTree::RayCastPacket(T* callback, const b2RayCastInput* inputs, int32 count) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	for (int32 base = 0; base < count; base += 4)
+	{
+		int32 packetCount = b2Min(4, count - base);
+
+		b2RayPacket packet;
+		packet.Set(inputs + base, packetCount);
+
+		// Visit the child nearest to the ray origins first so that hits clip the packet early.
+		b2Vec2 origin = inputs[base].p1;
+		b2Vec2 direction = inputs[base].p2 - inputs[base].p1;
+
+		int32 previousId = b2_nullNode;
+		int32 nodeId = m_root;
+
+		while (nodeId != b2_nullNode)
+		{
+			const b2TreeNode* node = m_nodes + nodeId;
+			int32 nextId = node->parent;
+
+			// The child order only depends on the packet, so it is the same on the way down and up.
+			int32 firstId = node->child1;
+			int32 secondId = node->child2;
+			if (node->IsLeaf() == false)
+			{
+				float d1 = b2Dot(m_nodes[firstId].aabb.GetCenter() - origin, direction);
+				float d2 = b2Dot(m_nodes[secondId].aabb.GetCenter() - origin, direction);
+				if (d2 < d1)
+				{
+					b2Swap(firstId, secondId);
+				}
+			}
+
+			if (previousId == node->parent)
+			{
+				uint32 mask = packet.TestAABB(node->aabb);
+				if (mask == 0)
+				{
+					// Go back up.
+				}
+				else if (node->IsLeaf())
+				{
+					for (int32 i = 0; i < packetCount; ++i)
+					{
+						if ((mask & (1u << i)) == 0)
+						{
+							continue;
+						}
+
+						b2RayCastInput subInput = inputs[base + i];
+						subInput.maxFraction = packet.maxFraction[i];
+
+						float value = callback->RayCastCallback(base + i, subInput, node->proxyId);
+
+						if (value == 0.0f)
+						{
+							// The client has terminated this ray.
+							packet.maxFraction[i] = -1.0f;
+						}
+						else if (value > 0.0f)
+						{
+							packet.maxFraction[i] = value;
+						}
+					}
+				}
+				else
+				{
+					nextId = firstId;
+				}
+			}
+			else if (previousId == firstId)
+			{
+				nextId = secondId;
+			}
 
+			previousId = nodeId;
+			nodeId = nextId;
+		}
+	}
+}
+
+template <typename T>
+inline void b2DynamicTree::QueryNearest(T* callback, const b2Vec2& point, float maxDistance) const
+{
+	QueryNearestNodes(callback, point, maxDistance, 0xFFFF, false);
+}
+
+template <typename T>
+inline void b2DynamicTree::QueryNearest(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits) const
+{
+	QueryNearestNodes(callback, point, maxDistance, maskBits, true);
+}
+
+template <typename T>
+inline void b2DynamicTree::QueryNearestNodes(T* callback, const b2Vec2& point, float maxDistance, uint16 maskBits, bool filter) const
+{
+	float maxDistanceSquared = maxDistance * maxDistance;
+
+	// Stackless traversal, see Query. The nearer child is visited first so that the
+	// search radius shrinks quickly.
+	int32 previousId = b2_nullNode;
+	int32 nodeId = m_root;
+
+	while (nodeId != b2_nullNode)
+	{
 		const b2TreeNode* node = m_nodes + nodeId;
+		int32 nextId = node->parent;
 
-		if (b2TestOverlap(node->aabb, aabb))
+		// The child order only depends on the point, so it is the same on the way down and up.
+		int32 firstId = node->child1;
+		int32 secondId = node->child2;
+		if (node->IsLeaf() == false)
 		{
-			if (node->IsLeaf())
+			float d1 = b2DistanceSquared(m_nodes[firstId].aabb, point);
+			float d2 = b2DistanceSquared(m_nodes[secondId].aabb, point);
+			if (d2 < d1)
 			{
-				bool proceed = callback->QueryCallback(nodeId);
-				if (proceed == false)
+				b2Swap(firstId, secondId);
+			}
+		}
+
+		if (previousId == node->parent)
+		{
+			if (b2DistanceSquared(node->aabb, point) > maxDistanceSquared || (filter && (node->categoryBits & maskBits) == 0))
+			{
+				// Go back up.
+			}
+			else if (node->IsLeaf())
+			{
+				float value = callback->QueryNearestCallback(node->proxyId, maxDistance);
+				if (value < 0.0f)
 				{
+					// The client has terminated the query.
 					return;
 				}
+
+				maxDistance = value;
+				maxDistanceSquared = value * value;
 			}
 			else
 			{
-				stack.Push(node->child1);
-				stack.Push(node->child2);
+				nextId = firstId;
 			}
 		}
+		else if (previousId == firstId)
+		{
+			nextId = secondId;
+		}
+
+		previousId = nodeId;
+		nodeId = nextId;
 	}
 }
 
 template <typename T>
 inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	RayCastNodes(callback, input, 0xFFFF, false);
+}
+
+template <typename T>
+inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits) const
+{
+	RayCastNodes(callback, input, maskBits, true);
+}
+
+template <typename T>
+inline void b2DynamicTree::RayCastNodes(T* callback, const b2RayCastInput& input, uint16 maskBits, bool filter) const
 {
 	b2Vec2 p1 = input.p1;
 	b2Vec2 p2 = input.p2;
@@ -245,63 +783,69 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 		segmentAABB.upperBound = b2Max(p1, t);
 	}
 
-	b2GrowableStack<int32, 256> stack;
-	stack.Push(m_root);
+	// Stackless traversal, see Query.
+	int32 previousId = b2_nullNode;
+	int32 nodeId = m_root;
 
-	while (stack.GetCount() > 0)
+	while (nodeId != b2_nullNode)
 	{
-		int32 nodeId = stack.Pop();
-		if (nodeId == b2_nullNode)
-		{
-			continue;
-		}
-
 		const b2TreeNode* node = m_nodes + nodeId;
+		int32 nextId = node->parent;
 
-		if (b2TestOverlap(node->aabb, segmentAABB) == false)
+		if (previousId == node->parent)
 		{
-			continue;
-		}
+			bool overlap = (filter == false || (node->categoryBits & maskBits) != 0);
+			overlap = overlap && b2TestOverlap(node->aabb, segmentAABB);
+			if (overlap)
+			{
+				// Separating axis for segment (Gino, p80).
+				// |dot(v, p1 - c)| > dot(|v|, h)
+				b2Vec2 c = node->aabb.GetCenter();
+				b2Vec2 h = node->aabb.GetExtents();
+				float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+				overlap = separation <= 0.0f;
+			}
 
-		// Separating axis for segment (Gino, p80).
-		// |dot(v, p1 - c)| > dot(|v|, h)
-		b2Vec2 c = node->aabb.GetCenter();
-		b2Vec2 h = node->aabb.GetExtents();
-		float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
-		if (separation > 0.0f)
-		{
-			continue;
-		}
+			if (overlap == false)
+			{
+				// Go back up.
+			}
+			else if (node->IsLeaf())
+			{
+				b2RayCastInput subInput;
+				subInput.p1 = input.p1;
+				subInput.p2 = input.p2;
+				subInput.maxFraction = maxFraction;
 
-		if (node->IsLeaf())
-		{
-			b2RayCastInput subInput;
-			subInput.p1 = input.p1;
-			subInput.p2 = input.p2;
-			subInput.maxFraction = maxFraction;
+				float value = callback->RayCastCallback(subInput, node->proxyId);
 
-			float value = callback->RayCastCallback(subInput, nodeId);
+				if (value == 0.0f)
+				{
+					// The client has terminated the ray cast.
+					return;
+				}
 
-			if (value == 0.0f)
-			{
-				// The client has terminated the ray cast.
-				return;
+				if (value > 0.0f)
+				{
+					// Update segment bounding box.
+					maxFraction = value;
+					b2Vec2 t = p1 + maxFraction * (p2 - p1);
+					segmentAABB.lowerBound = b2Min(p1, t);
+					segmentAABB.upperBound = b2Max(p1, t);
+				}
 			}
-
-			if (value > 0.0f)
+			else
 			{
-				// Update segment bounding box.
-				maxFraction = value;
-				b2Vec2 t = p1 + maxFraction * (p2 - p1);
-				segmentAABB.lowerBound = b2Min(p1, t);
-				segmentAABB.upperBound = b2Max(p1, t);
+				nextId = node->child1;
 			}
 		}
-		else
+		else if (previousId == node->child1)
 		{
-			stack.Push(node->child1);
-			stack.Push(node->child2);
+			nextId = node->child2;
 		}
+
+		previousId = nodeId;
+		nodeId = nextId;
 	}
 }
 
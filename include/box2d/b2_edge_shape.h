@@ -72,6 +72,15 @@ public:
 	bool m_oneSided;
 };
 
+/// Get the unit normal of the segment from v1 to v2. It points to the right looking from
+/// v1 to v2, which is the solid side of one-sided edges.
+inline b2Vec2 b2ComputeSegmentNormal(const b2Vec2& v1, const b2Vec2& v2)
+{
+	b2Vec2 edge = v2 - v1;
+	edge.Normalize();
+	return b2Vec2(edge.y, -edge.x);
+}
+
 inline b2EdgeShape::b2EdgeShape()
 {
 	m_type = e_edge;
@@ -41,6 +41,7 @@ struct B2_API b2Filter
 		categoryBits = 0x0001;
 		maskBits = 0xFFFF;
 		groupIndex = 0;
+		layer = 0;
 	}
 
 	/// The collision category bits. Normally you would just set one bit.
@@ -54,6 +55,10 @@ struct B2_API b2Filter
 	/// or always collide (positive). Zero means no collision group. Non-zero group
 	/// filtering always wins against the mask bits.
 	int16 groupIndex;
+
+	/// The collision layer, less than b2_maxLayers. Pairs of layers that are disabled
+	/// in the world layer matrix are rejected by the broad-phase.
+	uint8 layer;
 };
 
 /// A fixture definition is used to create a fixture. This class defines an
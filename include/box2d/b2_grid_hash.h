@@ -0,0 +1,539 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_GRID_HASH_H
+#define B2_GRID_HASH_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+#include "b2_dynamic_tree.h"
+
+/// A proxy in the grid broad-phase. The client does not interact with this directly.
+struct B2_API b2GridProxy
+{
+	/// Enlarged AABB
+	b2AABB aabb;
+
+	void* userData;
+
+	union
+	{
+		// Proxy id in the oversized tree, or b2_nullNode if the proxy is in the grid.
+		int32 treeProxyId;
+		int32 next;
+	};
+
+	// Covered cells, inclusive.
+	int32 lowerX, lowerY;
+	int32 upperX, upperY;
+
+	// free proxy = false
+	bool allocated;
+	bool moved;
+};
+
+/// A grid cell entry for a proxy. The client does not interact with this directly.
+struct B2_API b2GridEntry
+{
+	int32 cellX, cellY;
+
+	// free entry = b2_nullNode
+	int32 proxyId;
+
+	int32 next;
+};
+
+/// A broad-phase that hashes proxies into a uniform grid. This gives O(1) proxy
+/// movement and cheap neighbor queries when most objects have a similar size, such as
+/// piles of circles. The cell size should be close to the size of a typical object.
+/// Proxies spanning more than b2GridHash::e_maxSpan cells along an axis are
+/// stored in a small dynamic tree instead.
+///
+/// This has the same proxy contract as b2DynamicTree so that b2BroadPhase can
+/// use either one. Queries are reentrant.
+class B2_API b2GridHash
+{
+public:
+
+	enum
+	{
+		e_maxSpan = 3
+	};
+
+	/// No memory is allocated until the first proxy is created.
+	b2GridHash();
+
+	/// Destroy the grid, freeing the proxy pool.
+	~b2GridHash();
+
+	/// Set the cell size. This must be called while there are no proxies.
+	void SetCellSize(float cellSize);
+
+	/// Get the cell size.
+	float GetCellSize() const;
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the proxy is re-hashed. Otherwise the function returns immediately.
+	/// @return true if the fat AABB was updated.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Get the number of proxies.
+	int32 GetProxyCount() const;
+
+	/// Get the number of proxies that are too big for the grid.
+	int32 GetOversizedCount() const;
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called once for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies. This walks the cells along the ray and
+	/// calls the callback once for each proxy that is hit.
+	/// @param input the ray-cast input data. The ray extends from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param callback a callback class that is called for each proxy that is hit by the ray.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Validate the cell entries. For testing.
+	void Validate() const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+	/// Reorder the tree that holds oversized proxies. See b2DynamicTree::Relayout.
+	void Relayout();
+
+private:
+
+	template <typename T>
+	friend struct b2GridTreeWrapper;
+
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	int32 AllocateEntry();
+	void FreeEntry(int32 entryId);
+
+	void InsertProxy(int32 proxyId);
+	void RemoveProxy(int32 proxyId);
+
+	void Rehash(int32 bucketCount);
+
+	int32 GetCell(float x) const;
+	int32 GetBucket(int32 cellX, int32 cellY) const;
+
+	template <typename T>
+	bool RayCastProxy(T* callback, const b2RayCastInput& input, int32 proxyId, float* maxFraction) const;
+
+	float m_cellSize;
+	float m_inverseCellSize;
+
+	b2GridProxy* m_proxies;
+	int32 m_proxyCount;
+	int32 m_proxyCapacity;
+	int32 m_freeList;
+
+	b2GridEntry* m_entries;
+	int32 m_entryCount;
+	int32 m_entryCapacity;
+	int32 m_freeEntry;
+
+	// Heads of the entry lists. The count is a power of two.
+	int32* m_buckets;
+	int32 m_bucketCount;
+
+	// Oversized proxies. The user data is the grid proxy id.
+	b2DynamicTree m_tree;
+	int32 m_oversizedCount;
+};
+
+// Forwards callbacks from the oversized tree using grid proxy ids.
+template <typename T>
+struct b2GridTreeWrapper
+{
+	bool QueryCallback(int32 treeProxyId)
+	{
+		int32 proxyId = int32(uintptr_t(grid->m_tree.GetUserData(treeProxyId)));
+		if (b2TestOverlap(grid->m_proxies[proxyId].aabb, aabb) == false)
+		{
+			return true;
+		}
+
+		proceed = callback->QueryCallback(proxyId);
+		return proceed;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 treeProxyId)
+	{
+		int32 proxyId = int32(uintptr_t(grid->m_tree.GetUserData(treeProxyId)));
+		float value = input.maxFraction;
+		proceed = grid->RayCastProxy(callback, input, proxyId, &value);
+		maxFraction = value;
+		return proceed ? value : 0.0f;
+	}
+
+	const b2GridHash* grid;
+	T* callback;
+	b2AABB aabb;
+	float maxFraction;
+	bool proceed;
+};
+
+inline float b2GridHash::GetCellSize() const
+{
+	return m_cellSize;
+}
+
+inline void* b2GridHash::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline bool b2GridHash::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].moved;
+}
+
+inline void b2GridHash::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = false;
+}
+
+inline const b2AABB& b2GridHash::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int32 b2GridHash::GetProxyCount() const
+{
+	return m_proxyCount;
+}
+
+inline int32 b2GridHash::GetOversizedCount() const
+{
+	return m_oversizedCount;
+}
+
+inline void b2GridHash::Relayout()
+{
+	m_tree.Relayout();
+}
+
+inline int32 b2GridHash::GetCell(float x) const
+{
+	// Clamp so that far away proxies do not overflow the cell index.
+	float cell = floorf(b2Clamp(x * m_inverseCellSize, -1.0e9f, 1.0e9f));
+	return int32(cell);
+}
+
+inline int32 b2GridHash::GetBucket(int32 cellX, int32 cellY) const
+{
+	uint32 hash = (uint32(cellX) * 73856093u) ^ (uint32(cellY) * 19349663u);
+	return int32(hash & uint32(m_bucketCount - 1));
+}
+
+template <typename T>
+inline void b2GridHash::Query(T* callback, const b2AABB& aabb) const
+{
+	if (m_oversizedCount > 0)
+	{
+		b2GridTreeWrapper<T> wrapper;
+		wrapper.grid = this;
+		wrapper.callback = callback;
+		wrapper.aabb = aabb;
+		wrapper.proceed = true;
+		m_tree.Query(&wrapper, aabb);
+		if (wrapper.proceed == false)
+		{
+			return;
+		}
+	}
+
+	if (m_entryCount == 0)
+	{
+		return;
+	}
+
+	int32 lowerX = GetCell(aabb.lowerBound.x);
+	int32 lowerY = GetCell(aabb.lowerBound.y);
+	int32 upperX = GetCell(aabb.upperBound.x);
+	int32 upperY = GetCell(aabb.upperBound.y);
+
+	// Large queries are cheaper as a scan over the proxies.
+	float cellCount = float(upperX - lowerX + 1) * float(upperY - lowerY + 1);
+	if (cellCount > float(m_proxyCount))
+	{
+		for (int32 proxyId = 0; proxyId < m_proxyCapacity; ++proxyId)
+		{
+			const b2GridProxy* proxy = m_proxies + proxyId;
+			if (proxy->allocated == false || proxy->treeProxyId != b2_nullNode)
+			{
+				continue;
+			}
+
+			if (b2TestOverlap(proxy->aabb, aabb))
+			{
+				bool proceed = callback->QueryCallback(proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+
+		return;
+	}
+
+	for (int32 y = lowerY; y <= upperY; ++y)
+	{
+		for (int32 x = lowerX; x <= upperX; ++x)
+		{
+			int32 entryId = m_buckets[GetBucket(x, y)];
+			while (entryId != b2_nullNode)
+			{
+				const b2GridEntry* entry = m_entries + entryId;
+				entryId = entry->next;
+
+				if (entry->cellX != x || entry->cellY != y)
+				{
+					continue;
+				}
+
+				// A proxy may cover several cells of the query. Only report it from
+				// the lowest cell that is covered by both.
+				const b2GridProxy* proxy = m_proxies + entry->proxyId;
+				if (x != b2Max(proxy->lowerX, lowerX) || y != b2Max(proxy->lowerY, lowerY))
+				{
+					continue;
+				}
+
+				if (b2TestOverlap(proxy->aabb, aabb))
+				{
+					bool proceed = callback->QueryCallback(entry->proxyId);
+					if (proceed == false)
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+inline bool b2GridHash::RayCastProxy(T* callback, const b2RayCastInput& input, int32 proxyId, float* maxFraction) const
+{
+	const b2AABB& aabb = m_proxies[proxyId].aabb;
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 t = p1 + *maxFraction * (input.p2 - p1);
+	b2AABB segmentAABB;
+	segmentAABB.lowerBound = b2Min(p1, t);
+	segmentAABB.upperBound = b2Max(p1, t);
+	if (b2TestOverlap(aabb, segmentAABB) == false)
+	{
+		return true;
+	}
+
+	// Separating axis for segment (Gino, p80).
+	// |dot(v, p1 - c)| > dot(|v|, h)
+	b2Vec2 r = input.p2 - p1;
+	r.Normalize();
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 c = aabb.GetCenter();
+	b2Vec2 h = aabb.GetExtents();
+	float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(b2Abs(v), h);
+	if (separation > 0.0f)
+	{
+		return true;
+	}
+
+	b2RayCastInput subInput;
+	subInput.p1 = input.p1;
+	subInput.p2 = input.p2;
+	subInput.maxFraction = *maxFraction;
+
+	float value = callback->RayCastCallback(subInput, proxyId);
+
+	if (value == 0.0f)
+	{
+		// The client has terminated the ray cast.
+		return false;
+	}
+
+	if (value > 0.0f)
+	{
+		*maxFraction = value;
+	}
+
+	return true;
+}
+
+template <typename T>
+inline void b2GridHash::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 d = p2 - p1;
+	b2Assert(d.LengthSquared() > 0.0f);
+
+	float maxFraction = input.maxFraction;
+
+	if (m_oversizedCount > 0)
+	{
+		b2GridTreeWrapper<T> wrapper;
+		wrapper.grid = this;
+		wrapper.callback = callback;
+		wrapper.maxFraction = maxFraction;
+		wrapper.proceed = true;
+		m_tree.RayCast(&wrapper, input);
+		if (wrapper.proceed == false)
+		{
+			return;
+		}
+
+		maxFraction = wrapper.maxFraction;
+	}
+
+	if (m_entryCount == 0)
+	{
+		return;
+	}
+
+	b2Vec2 t = p1 + maxFraction * d;
+	int32 x = GetCell(p1.x);
+	int32 y = GetCell(p1.y);
+	int32 endX = GetCell(t.x);
+	int32 endY = GetCell(t.y);
+
+	// Long rays are cheaper as a scan over the proxies.
+	float cellCount = float(b2Abs(endX - x) + b2Abs(endY - y) + 1);
+	if (cellCount > float(m_proxyCount))
+	{
+		for (int32 proxyId = 0; proxyId < m_proxyCapacity; ++proxyId)
+		{
+			const b2GridProxy* proxy = m_proxies + proxyId;
+			if (proxy->allocated == false || proxy->treeProxyId != b2_nullNode)
+			{
+				continue;
+			}
+
+			if (RayCastProxy(callback, input, proxyId, &maxFraction) == false)
+			{
+				return;
+			}
+		}
+
+		return;
+	}
+
+	// Walk the cells along the ray (Amanatides and Woo).
+	int32 stepX = d.x > 0.0f ? 1 : -1;
+	int32 stepY = d.y > 0.0f ? 1 : -1;
+
+	float tDeltaX = d.x != 0.0f ? m_cellSize / b2Abs(d.x) : b2_maxFloat;
+	float tDeltaY = d.y != 0.0f ? m_cellSize / b2Abs(d.y) : b2_maxFloat;
+
+	float boundaryX = (stepX > 0 ? float(x + 1) : float(x)) * m_cellSize;
+	float boundaryY = (stepY > 0 ? float(y + 1) : float(y)) * m_cellSize;
+	float tMaxX = d.x != 0.0f ? (boundaryX - p1.x) / d.x : b2_maxFloat;
+	float tMaxY = d.y != 0.0f ? (boundaryY - p1.y) / d.y : b2_maxFloat;
+
+	int32 prevX = x - stepX;
+	int32 prevY = y - stepY;
+	bool first = true;
+
+	for (;;)
+	{
+		int32 entryId = m_buckets[GetBucket(x, y)];
+		while (entryId != b2_nullNode)
+		{
+			const b2GridEntry* entry = m_entries + entryId;
+			entryId = entry->next;
+
+			if (entry->cellX != x || entry->cellY != y)
+			{
+				continue;
+			}
+
+			// A ray cannot re-enter a box, so a proxy is reported from the
+			// first cell it covers along the ray.
+			const b2GridProxy* proxy = m_proxies + entry->proxyId;
+			bool covered = proxy->lowerX <= prevX && prevX <= proxy->upperX && proxy->lowerY <= prevY && prevY <= proxy->upperY;
+			if (first == false && covered)
+			{
+				continue;
+			}
+
+			if (RayCastProxy(callback, input, entry->proxyId, &maxFraction) == false)
+			{
+				return;
+			}
+		}
+
+		// Advance to the next cell unless the ray ends in this one.
+		float tNext = b2Min(tMaxX, tMaxY);
+		if (tNext > maxFraction)
+		{
+			return;
+		}
+
+		prevX = x;
+		prevY = y;
+		first = false;
+
+		if (tMaxX < tMaxY)
+		{
+			x += stepX;
+			tMaxX += tDeltaX;
+		}
+		else
+		{
+			y += stepY;
+			tMaxY += tDeltaY;
+		}
+	}
+}
+
+#endif
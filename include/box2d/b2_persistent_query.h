@@ -0,0 +1,161 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_PERSISTENT_QUERY_H
+#define B2_PERSISTENT_QUERY_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+#include "b2_math.h"
+
+class b2Fixture;
+class b2World;
+
+/// A persistent query remembers the fixtures that potentially overlap an AABB. The
+/// query is only run again after a proxy in its AABB was created, moved out of its fat
+/// AABB, or destroyed. So polling a query each step costs almost nothing while the
+/// nearby bodies are asleep or moving slowly. Create these with b2World::CreatePersistentQuery.
+/// The fixtures are found with fat AABBs, as in b2World::QueryAABB.
+class B2_API b2PersistentQuery
+{
+public:
+
+	/// Set the query AABB. This invalidates the result.
+	void SetAABB(const b2AABB& aabb);
+
+	/// Get the query AABB.
+	const b2AABB& GetAABB() const;
+
+	/// Bring the result up to date. This runs the query only if it is invalid.
+	/// @return the number of fixtures found.
+	int32 Update();
+
+	/// Get the number of fixtures found by the last update.
+	int32 GetFixtureCount() const;
+
+	/// Get a fixture found by the last update.
+	b2Fixture* GetFixture(int32 index) const;
+
+	/// Does the next update need to run the query? For testing.
+	bool IsValid() const;
+
+	/// Get the next query in the world's query list.
+	b2PersistentQuery* GetNext();
+	const b2PersistentQuery* GetNext() const;
+
+	/// Get the user data pointer.
+	void* GetUserData() const;
+
+	/// Set the user data.
+	void SetUserData(void* data);
+
+private:
+
+	friend class b2World;
+	friend struct b2PersistentQueryWrapper;
+
+	struct Entry
+	{
+		bool operator<(const Entry& other) const
+		{
+			return proxyId < other.proxyId;
+		}
+
+		int32 proxyId;
+		b2Fixture* fixture;
+	};
+
+	b2PersistentQuery(b2World* world, const b2AABB& aabb);
+	~b2PersistentQuery();
+
+	// Invalidate the result if the proxy was found by the last update.
+	void TouchProxy(int32 proxyId);
+
+	// Invalidate the result if the proxy was found by the last update or now overlaps the AABB.
+	void TouchProxy(int32 proxyId, const b2AABB& fatAABB);
+
+	// Touch the buffered proxy moves that this query has not seen yet.
+	void TouchMovedProxies();
+
+	void AddEntry(int32 proxyId, b2Fixture* fixture);
+
+	b2World* m_world;
+	b2PersistentQuery* m_prev;
+	b2PersistentQuery* m_next;
+
+	b2AABB m_aabb;
+
+	// Sorted by proxy id.
+	Entry* m_entries;
+	int32 m_count;
+	int32 m_capacity;
+
+	// Moves before this index in the move buffer of this epoch have been seen.
+	int32 m_moveEpoch;
+	int32 m_moveIndex;
+
+	bool m_valid;
+	void* m_userData;
+};
+
+inline const b2AABB& b2PersistentQuery::GetAABB() const
+{
+	return m_aabb;
+}
+
+inline int32 b2PersistentQuery::GetFixtureCount() const
+{
+	return m_count;
+}
+
+inline b2Fixture* b2PersistentQuery::GetFixture(int32 index) const
+{
+	b2Assert(0 <= index && index < m_count);
+	return m_entries[index].fixture;
+}
+
+inline bool b2PersistentQuery::IsValid() const
+{
+	return m_valid;
+}
+
+inline b2PersistentQuery* b2PersistentQuery::GetNext()
+{
+	return m_next;
+}
+
+inline const b2PersistentQuery* b2PersistentQuery::GetNext() const
+{
+	return m_next;
+}
+
+inline void* b2PersistentQuery::GetUserData() const
+{
+	return m_userData;
+}
+
+inline void b2PersistentQuery::SetUserData(void* data)
+{
+	m_userData = data;
+}
+
+#endif
@@ -78,10 +78,18 @@ public:
 	/// @returns true if valid
 	bool Validate() const;
 
+	/// Get the half extents of a polygon made by SetAsBox.
+	b2Vec2 GetBoxExtents() const;
+
 	b2Vec2 m_centroid;
+	int32 m_count;
+
+	/// True if the polygon was made by SetAsBox. Boxes use faster colliders.
+	/// Clear this if you edit the vertices directly.
+	bool m_isBox;
+
 	b2Vec2 m_vertices[b2_maxPolygonVertices];
 	b2Vec2 m_normals[b2_maxPolygonVertices];
-	int32 m_count;
 };
 
 inline b2PolygonShape::b2PolygonShape()
@@ -90,6 +98,14 @@ inline b2PolygonShape::b2PolygonShape()
 	m_radius = b2_polygonRadius;
 	m_count = 0;
 	m_centroid.SetZero();
+	m_isBox = false;
+}
+
+inline b2Vec2 b2PolygonShape::GetBoxExtents() const
+{
+	b2Assert(m_isBox);
+	b2Vec2 d = m_vertices[2] - m_centroid;
+	return b2Vec2(b2Dot(m_normals[1], d), b2Dot(m_normals[2], d));
 }
 
 #endif
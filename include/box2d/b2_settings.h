@@ -48,9 +48,15 @@
 /// For example for inches you could use 39.4.
 #define b2_lengthUnitsPerMeter 1.0f
 
-/// The maximum number of vertices on a convex polygon. You cannot increase
-/// this too much because b2BlockAllocator has a maximum object size.
+/// The maximum number of vertices on a convex polygon. Define B2_LARGE_POLYGONS to raise
+/// it to 32. Polygons with many vertices use hill climbing collision, so the cost per
+/// contact grows slowly with the count, but every polygon gets larger.
+/// You cannot increase this too much because b2BlockAllocator has a maximum object size.
+#if defined(B2_LARGE_POLYGONS)
+#define b2_maxPolygonVertices	32
+#else
 #define b2_maxPolygonVertices	8
+#endif
 
 // User data
 
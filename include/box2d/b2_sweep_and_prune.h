@@ -0,0 +1,356 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_SWEEP_AND_PRUNE_H
+#define B2_SWEEP_AND_PRUNE_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+#include "b2_dynamic_tree.h"
+
+/// A proxy in the sweep-and-prune broad-phase. The client does not interact with this directly.
+struct B2_API b2SweepProxy
+{
+	void* userData;
+
+	union
+	{
+		int32 sortIndex;
+		int32 next;
+	};
+
+	// free proxy = false
+	bool allocated;
+	bool moved;
+};
+
+/// An entry in the sorted axis. The client does not interact with this directly.
+struct B2_API b2SweepEntry
+{
+	/// Enlarged AABB
+	b2AABB aabb;
+
+	int32 proxyId;
+};
+
+/// A sweep-and-prune broad-phase that keeps proxies sorted along the x-axis.
+/// This suits worlds that are spread out along one axis, such as side scrollers.
+/// The sort is maintained incrementally, so temporal coherence keeps proxy
+/// movement cheap. Proxy AABBs are enlarged the same way as in b2DynamicTree.
+///
+/// This has the same proxy contract as b2DynamicTree so that b2BroadPhase can
+/// use either one. Creating and destroying proxies is O(n) in the worst case
+/// because the sorted array is shifted. Bulk loading in order of increasing x is O(1) per proxy.
+class B2_API b2SweepAndPrune
+{
+public:
+	/// No memory is allocated until the first proxy is created.
+	b2SweepAndPrune();
+
+	/// Destroy the sweep-and-prune, freeing the proxy pool.
+	~b2SweepAndPrune();
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the proxy is re-sorted. Otherwise the function returns immediately.
+	/// @return true if the proxy was re-sorted.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Flag a proxy as moved so that FindPairs reports its pairs.
+	void MarkMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Get the number of proxies.
+	int32 GetProxyCount() const;
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies. This relies on the callback
+	/// to perform a exact ray-cast in the case were the proxy contains a shape.
+	/// @param input the ray-cast input data. The ray extends from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param callback a callback class that is called for each proxy that is hit by the ray.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Sweep the sorted axis once and report every overlapping pair where at least one
+	/// proxy was moved. Each pair is reported once through callback->BufferPair.
+	/// This is O(n + k) where k is the number of overlaps along the x-axis.
+	template <typename T>
+	void FindPairs(T* callback);
+
+	/// Validate the sort order. For testing.
+	void Validate() const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+private:
+
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	// Find the first entry with a lower x-bound not less than x.
+	int32 LowerBound(float x) const;
+
+	// Insertion sort a single entry into place.
+	void SortEntry(int32 index);
+
+	b2SweepProxy* m_proxies;
+	int32 m_proxyCount;
+	int32 m_proxyCapacity;
+	int32 m_freeList;
+
+	// Sorted by aabb.lowerBound.x. The capacity matches the proxy capacity.
+	b2SweepEntry* m_entries;
+
+	// Scratch buffer of active entries for FindPairs.
+	int32* m_active;
+
+	// An upper bound on the x-extent of any proxy. This bounds the
+	// backward search for proxies that overlap a query.
+	float m_maxExtent;
+};
+
+inline void* b2SweepAndPrune::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline bool b2SweepAndPrune::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].moved;
+}
+
+inline void b2SweepAndPrune::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = false;
+}
+
+inline void b2SweepAndPrune::MarkMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = true;
+}
+
+inline const b2AABB& b2SweepAndPrune::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+	return m_entries[m_proxies[proxyId].sortIndex].aabb;
+}
+
+inline int32 b2SweepAndPrune::GetProxyCount() const
+{
+	return m_proxyCount;
+}
+
+inline int32 b2SweepAndPrune::LowerBound(float x) const
+{
+	int32 low = 0;
+	int32 high = m_proxyCount;
+	while (low < high)
+	{
+		int32 mid = (low + high) >> 1;
+		if (m_entries[mid].aabb.lowerBound.x < x)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+template <typename T>
+inline void b2SweepAndPrune::Query(T* callback, const b2AABB& aabb) const
+{
+	// Proxies that start further left than the maximum extent cannot reach the query.
+	int32 index = LowerBound(aabb.lowerBound.x - m_maxExtent);
+
+	for (; index < m_proxyCount; ++index)
+	{
+		const b2SweepEntry* entry = m_entries + index;
+		if (entry->aabb.lowerBound.x > aabb.upperBound.x)
+		{
+			// All remaining proxies are to the right of the query.
+			return;
+		}
+
+		if (b2TestOverlap(entry->aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(entry->proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2SweepAndPrune::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	int32 index = LowerBound(segmentAABB.lowerBound.x - m_maxExtent);
+
+	for (; index < m_proxyCount; ++index)
+	{
+		const b2SweepEntry* entry = m_entries + index;
+
+		// The segment bounding box only shrinks, so this test remains valid.
+		if (entry->aabb.lowerBound.x > segmentAABB.upperBound.x)
+		{
+			return;
+		}
+
+		if (b2TestOverlap(entry->aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = entry->aabb.GetCenter();
+		b2Vec2 h = entry->aabb.GetExtents();
+		float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		b2RayCastInput subInput;
+		subInput.p1 = input.p1;
+		subInput.p2 = input.p2;
+		subInput.maxFraction = maxFraction;
+
+		float value = callback->RayCastCallback(subInput, entry->proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			// Update segment bounding box.
+			maxFraction = value;
+			b2Vec2 t = p1 + maxFraction * (p2 - p1);
+			segmentAABB.lowerBound = b2Min(p1, t);
+			segmentAABB.upperBound = b2Max(p1, t);
+		}
+	}
+}
+
+template <typename T>
+void b2SweepAndPrune::FindPairs(T* callback)
+{
+	// Recompute the exact extent bound while sweeping.
+	float maxExtent = 0.0f;
+
+	// Active entries have not yet been passed by the sweep line.
+	int32 activeCount = 0;
+
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+		maxExtent = b2Max(maxExtent, entry->aabb.upperBound.x - entry->aabb.lowerBound.x);
+		bool moved = m_proxies[entry->proxyId].moved;
+
+		// Prune entries left behind by the sweep line and report overlaps with the rest.
+		int32 keepCount = 0;
+		for (int32 j = 0; j < activeCount; ++j)
+		{
+			const b2SweepEntry* other = m_entries + m_active[j];
+			if (other->aabb.upperBound.x < entry->aabb.lowerBound.x)
+			{
+				continue;
+			}
+
+			m_active[keepCount] = m_active[j];
+			++keepCount;
+
+			if (moved == false && m_proxies[other->proxyId].moved == false)
+			{
+				continue;
+			}
+
+			if (other->aabb.upperBound.y < entry->aabb.lowerBound.y || entry->aabb.upperBound.y < other->aabb.lowerBound.y)
+			{
+				continue;
+			}
+
+			callback->BufferPair(entry->proxyId, other->proxyId);
+		}
+
+		activeCount = keepCount;
+		m_active[activeCount] = i;
+		++activeCount;
+	}
+
+	m_maxExtent = maxExtent;
+}
+
+#endif
@@ -47,6 +47,7 @@ struct B2_API b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool speculative;	// points with positive separation are speculative contacts
 };
 
 /// This is an internal structure.
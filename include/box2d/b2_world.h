@@ -26,7 +26,10 @@
 #include "b2_api.h"
 #include "b2_block_allocator.h"
 #include "b2_contact_manager.h"
+#include "b2_distance.h"
+#include "b2_fixture.h"
 #include "b2_math.h"
+#include "b2_persistent_query.h"
 #include "b2_stack_allocator.h"
 #include "b2_time_step.h"
 #include "b2_world_callbacks.h"
@@ -34,11 +37,59 @@
 struct b2AABB;
 struct b2BodyDef;
 struct b2Color;
+struct b2Filter;
 struct b2JointDef;
 class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+class b2Shape;
+
+/// Warm starting data for repeated b2World::OverlapShape queries. Keep one cache per
+/// query shape, such as a trigger volume tested every step. The cache remembers the
+/// GJK simplex of each fixture found by the last query so that the next query starts
+/// from it. A cache must not be shared by threads running queries at the same time.
+class B2_API b2OverlapCache
+{
+public:
+	b2OverlapCache();
+	~b2OverlapCache();
+
+	/// Forget all cached simplices. Call this if the query shape changes.
+	void Clear();
+
+private:
+
+	friend class b2World;
+	friend struct b2WorldOverlapWrapper;
+
+	struct Entry
+	{
+		bool operator<(const Entry& other) const
+		{
+			return proxyId < other.proxyId;
+		}
+
+		const b2Fixture* fixture;
+		int32 proxyId;
+		int32 childIndex;
+		b2SimplexCache cache;
+	};
+
+	b2SimplexCache* Find(const b2Fixture* fixture, int32 proxyId, int32 childIndex);
+	b2SimplexCache* Add(const b2Fixture* fixture, int32 proxyId, int32 childIndex, const b2SimplexCache& cache);
+	void Swap();
+
+	// Entries from the last query sorted by proxy id.
+	Entry* m_entries;
+	int32 m_count;
+	int32 m_capacity;
+
+	// Entries of the current query.
+	Entry* m_nextEntries;
+	int32 m_nextCount;
+	int32 m_nextCapacity;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -114,18 +165,171 @@ public:
 
 	/// Query the world for all fixtures that potentially overlap the
 	/// provided AABB.
+	/// This may be called from several threads at once as long as the world is not
+	/// being modified or stepped.
 	/// @param callback a user implemented callback class.
 	/// @param aabb the query box.
 	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const;
 
+	/// Query the world for fixtures that potentially overlap the provided AABB and pass
+	/// the filter. A fixture passes if it would collide with a fixture that has this
+	/// filter. The dynamic tree skips subtrees that have no category in the filter mask.
+	/// @param callback a user implemented callback class.
+	/// @param aabb the query box.
+	/// @param filter the query filter.
+	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, const b2Filter& filter) const;
+
+	/// Query the world with many AABBs at once. Each fixture that potentially overlaps
+	/// a query AABB is written to the hit buffer. The queries are grouped spatially so that
+	/// nearby queries share the tree traversal. Hits are not ordered by query index.
+	/// This may be called from several threads at once, each with its own range of AABBs
+	/// and hit buffer, as long as the world is not modified. The query index is relative
+	/// to the supplied array.
+	/// @param aabbs the query boxes.
+	/// @param count the number of query boxes.
+	/// @param hits the hit buffer.
+	/// @param capacity the capacity of the hit buffer.
+	/// @return the number of hits. If this exceeds the capacity then only capacity
+	/// hits were written and the query should be repeated with a bigger buffer.
+	int32 QueryAABBBatch(const b2AABB* aabbs, int32 count, b2QueryHit* hits, int32 capacity) const;
+
+	/// Query the world with any callable, such as a lambda. The callable is inlined into the
+	/// tree traversal, so there is no virtual call per fixture.
+	/// @param aabb the query box.
+	/// @param fcn called as bool fcn(b2Fixture* fixture). Return false to terminate the query.
+	template <typename T>
+	void QueryAABB(const b2AABB& aabb, T fcn) const;
+
 	/// Ray-cast the world for all fixtures in the path of the ray. Your callback
 	/// controls whether you get the closest point, any point, or n-points.
 	/// The ray-cast ignores shapes that contain the starting point.
+	/// Like QueryAABB, this may be called from several threads.
 	/// @param callback a user implemented callback class.
 	/// @param point1 the ray starting point
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Ray-cast the world for the fixtures that pass the filter. See QueryAABB.
+	/// @param callback a user implemented callback class.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param filter the query filter.
+	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2, const b2Filter& filter) const;
+
+	/// Ray-cast the world with any callable, such as a lambda. See QueryAABB.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param fcn called as float fcn(b2Fixture* fixture, const b2Vec2& point, const b2Vec2& normal, float fraction).
+	/// The return value has the same meaning as b2RayCastCallback::ReportFixture.
+	template <typename T>
+	void RayCast(const b2Vec2& point1, const b2Vec2& point2, T fcn) const;
+
+	/// Find the closest fixture in the path of the ray. The ray is clipped at each hit so
+	/// farther fixtures are culled from the traversal.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param hit receives the closest hit. Unchanged when there is no hit.
+	/// @return true if the ray hit a fixture.
+	bool RayCastClosest(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hit) const;
+
+	/// Find any fixture in the path of the ray. The ray-cast stops at the first hit, which
+	/// makes this the cheapest line of sight test.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param hit receives the hit. Unchanged when there is no hit. May be nullptr.
+	/// @return true if the ray hit a fixture.
+	bool RayCastAny(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hit) const;
+
+	/// Ray-cast the world with many rays and find the closest hit of each ray. The rays are
+	/// traversed in packets of four with SIMD slab tests, so neighboring rays should be
+	/// coherent, such as a fan of sensor rays. The ray-cast ignores shapes that contain
+	/// the starting point. Like QueryAABBBatch, this may be called from several threads.
+	/// @param inputs the rays. Each ray extends from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param hits receives the closest hit of each ray.
+	/// @param count the number of rays.
+	void RayCastBatch(const b2RayCastInput* inputs, b2RayCastHit* hits, int32 count) const;
+
+	/// Sweep a shape through the world and find the first fixture it hits. The broad-phase
+	/// is queried with the swept AABB and each candidate is tested with b2ShapeCast. The
+	/// sweep is shortened at each hit so that farther candidates are rejected early.
+	/// Fixtures that overlap the shape at the start are ignored. Chain shapes sweep their
+	/// first edge. Like QueryAABB, this may be called from several threads.
+	/// @param shape the swept shape.
+	/// @param transform the starting transform of the shape.
+	/// @param translation the sweep translation.
+	/// @param hit receives the first hit. The point and normal are on the surface of the
+	/// hit fixture and the fraction is the fraction of the translation. Unchanged when
+	/// there is no hit.
+	/// @return true if the shape hit a fixture.
+	bool ShapeCast(const b2Shape* shape, const b2Transform& transform, const b2Vec2& translation, b2RayCastHit* hit) const;
+
+	/// Sweep many shapes through the world. See ShapeCast.
+	/// @param queries the sweeps.
+	/// @param hits receives the first hit of each sweep. The fixture is nullptr for a miss.
+	/// @param count the number of sweeps.
+	void ShapeCastBatch(const b2ShapeCastQuery* queries, b2RayCastHit* hits, int32 count) const;
+
+	/// Query the world for fixtures that overlap a shape. Candidates from the broad-phase
+	/// are tested exactly with GJK. A chain fixture is reported once for each overlapping
+	/// child. Chain shapes use their first edge as the query shape. Like QueryAABB, this
+	/// may be called from several threads.
+	/// @param callback a user implemented callback class.
+	/// @param shape the query shape.
+	/// @param transform the transform of the query shape.
+	void OverlapShape(b2QueryCallback* callback, const b2Shape* shape, const b2Transform& transform) const;
+
+	/// Query the world for fixtures that overlap a shape and pass the filter. See QueryAABB
+	/// for the filter rules.
+	/// @param callback a user implemented callback class.
+	/// @param shape the query shape.
+	/// @param transform the transform of the query shape.
+	/// @param filter the query filter.
+	/// @param cache warm starting data for a shape that is queried repeatedly. May be nullptr.
+	void OverlapShape(b2QueryCallback* callback, const b2Shape* shape, const b2Transform& transform,
+						const b2Filter& filter, b2OverlapCache* cache) const;
+
+	/// Query the world with many shapes at once. See OverlapShape and QueryAABBBatch.
+	/// @param queries the query shapes.
+	/// @param count the number of query shapes.
+	/// @param filter the query filter.
+	/// @param hits the hit buffer.
+	/// @param capacity the capacity of the hit buffer.
+	/// @return the number of hits. If this exceeds the capacity then only capacity
+	/// hits were written.
+	int32 OverlapShapeBatch(const b2ShapeQuery* queries, int32 count, const b2Filter& filter,
+							b2QueryHit* hits, int32 capacity) const;
+
+	/// Find the fixture nearest to a point. The dynamic tree is searched nearest first and
+	/// subtrees beyond the closest fixture found so far are skipped. Distances are exact.
+	/// Like QueryAABB, this may be called from several threads.
+	/// @param point the query point.
+	/// @param maxDistance fixtures farther than this are ignored. Use b2_maxFloat for no limit.
+	/// @param hit receives the nearest fixture. Unchanged when nothing is found.
+	/// @return true if a fixture was found.
+	bool NearestFixture(const b2Vec2& point, float maxDistance, b2NearestHit* hit) const;
+
+	/// Find the k fixtures nearest to a point that pass the filter. See NearestFixture and
+	/// QueryAABB. A chain fixture may be found once for each child.
+	/// @param point the query point.
+	/// @param maxDistance fixtures farther than this are ignored.
+	/// @param filter the query filter.
+	/// @param hits receives the nearest fixtures sorted by distance.
+	/// @param k the capacity of the hit array.
+	/// @return the number of fixtures found, at most k.
+	int32 NearestFixtures(const b2Vec2& point, float maxDistance, const b2Filter& filter, b2NearestHit* hits, int32 k) const;
+
+	/// Create a persistent query for an AABB. The query keeps its result between time steps
+	/// and only runs again when a proxy in its AABB changes.
+	/// @see b2PersistentQuery
+	b2PersistentQuery* CreatePersistentQuery(const b2AABB& aabb);
+
+	/// Destroy a persistent query.
+	void DestroyPersistentQuery(b2PersistentQuery* query);
+
+	/// Get the world persistent query list.
+	b2PersistentQuery* GetPersistentQueryList();
+	const b2PersistentQuery* GetPersistentQueryList() const;
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A nullptr body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -162,6 +366,44 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable manifold reuse. Contacts whose bodies moved less than
+	/// b2_manifoldLinearTolerance and b2_manifoldAngularTolerance relative to each other since
+	/// their manifold was computed keep that manifold instead of colliding the shapes again.
+	/// This speeds up resting stacks. It is off by default. If you edit a shape in place,
+	/// call b2Fixture::Refilter so its contacts compute fresh manifolds.
+	void SetManifoldReuse(bool flag);
+	bool GetManifoldReuse() const;
+
+	/// Get the number of contacts that reused their manifold in the last step.
+	int32 GetReusedManifoldCount() const;
+
+	/// Enable/disable speculative contacts. This is an alternative to time of impact for
+	/// continuous collision. Shapes that are apart but closing fast enough to meet within
+	/// the time step get a contact point with positive separation, and the regular solver
+	/// stops them at the surface. The time of impact pass then only handles bullets.
+	/// Speculative points make a contact touching, so BeginContact can be reported
+	/// slightly before the shapes meet. Restitution is applied after the velocity
+	/// iterations, so speculative points bounce with the speed they had before the step.
+	/// It is off by default.
+	void SetSpeculativeContacts(bool flag) { m_speculativeContacts = flag; }
+	bool GetSpeculativeContacts() const { return m_speculativeContacts; }
+
+	/// Choose the broad-phase proxy structure. Existing proxies are moved to the new
+	/// structure and existing contacts are kept. The default is b2_dynamicTreeBroadPhase.
+	/// @warning This function is locked during callbacks.
+	void SetBroadPhaseType(b2BroadPhaseType type);
+
+	/// Get the broad-phase proxy structure.
+	b2BroadPhaseType GetBroadPhaseType() const;
+
+	/// Set the cell size of the b2_gridBroadPhase structure. This should be close to
+	/// the size of a typical fixture. The default is b2_gridCellSize.
+	/// @warning This function is locked during callbacks.
+	void SetGridCellSize(float cellSize);
+
+	/// Get the cell size of the b2_gridBroadPhase structure.
+	float GetGridCellSize() const;
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -204,6 +446,22 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Reorder the broad-phase storage for cache friendly queries. Long running
+	/// simulations can call this occasionally, such as every few thousand steps.
+	void RelayoutBroadPhase();
+
+	/// Enable or disable collision between two layers. All layers collide by default.
+	/// Pairs between disabled layers are rejected in the broad-phase before any other
+	/// filtering. Changing the matrix refilters every fixture, so do this at setup.
+	/// @see b2Filter::layer
+	void SetLayerCollision(int32 layerA, int32 layerB, bool flag);
+
+	/// Do fixtures in these two layers collide?
+	bool GetLayerCollision(int32 layerA, int32 layerB) const;
+
+	/// Get the number of broad-phase pairs rejected by the layer matrix in the last step.
+	int32 GetRejectedPairCount() const;
+
 	/// Get the contact manager for testing.
 	const b2ContactManager& GetContactManager() const;
 
@@ -220,10 +478,20 @@ private:
 	friend class b2Fixture;
 	friend class b2ContactManager;
 	friend class b2Controller;
+	friend class b2PersistentQuery;
 
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
 
+	void RebuildBroadPhase(b2BroadPhaseType type, float gridCellSize);
+
+	// Invalidate the persistent queries affected by the buffered proxy moves.
+	// Call this before the move buffer is flushed.
+	void InvalidateQueries();
+
+	// Invalidate the persistent queries that found a destroyed proxy.
+	void InvalidateQueries(int32 proxyId);
+
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
 	b2BlockAllocator m_blockAllocator;
@@ -233,6 +501,11 @@ private:
 
 	b2Body* m_bodyList;
 	b2Joint* m_jointList;
+	b2PersistentQuery* m_queryList;
+
+	// Counts the move buffer flushes so that persistent queries can skip the moves
+	// they have already seen.
+	int32 m_moveEpoch;
 
 	int32 m_bodyCount;
 	int32 m_jointCount;
@@ -255,6 +528,7 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_speculativeContacts;
 
 	bool m_stepComplete;
 
@@ -291,6 +565,16 @@ inline const b2Contact* b2World::GetContactList() const
 	return m_contactManager.m_contactList;
 }
 
+inline b2PersistentQuery* b2World::GetPersistentQueryList()
+{
+	return m_queryList;
+}
+
+inline const b2PersistentQuery* b2World::GetPersistentQueryList() const
+{
+	return m_queryList;
+}
+
 inline int32 b2World::GetBodyCount() const
 {
 	return m_bodyCount;
@@ -332,6 +616,16 @@ inline bool b2World::GetAutoClearForces() const
 	return m_clearForces;
 }
 
+inline b2BroadPhaseType b2World::GetBroadPhaseType() const
+{
+	return m_contactManager.m_broadPhase.GetType();
+}
+
+inline float b2World::GetGridCellSize() const
+{
+	return m_contactManager.m_broadPhase.GetGridCellSize();
+}
+
 inline const b2ContactManager& b2World::GetContactManager() const
 {
 	return m_contactManager;
@@ -342,4 +636,65 @@ inline const b2Profile& b2World::GetProfile() const
 	return m_profile;
 }
 
+/// This is used internally to adapt a callable to the broad-phase query.
+template <typename T>
+struct b2WorldQueryFunction
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		return (*fcn)(proxy->fixture);
+	}
+
+	const b2BroadPhase* broadPhase;
+	T* fcn;
+};
+
+/// This is used internally to adapt a callable to the broad-phase ray-cast.
+template <typename T>
+struct b2WorldRayCastFunction
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, proxy->childIndex);
+
+		if (hit)
+		{
+			float fraction = output.fraction;
+			b2Vec2 point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			return (*fcn)(fixture, point, output.normal, fraction);
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	T* fcn;
+};
+
+template <typename T>
+inline void b2World::QueryAABB(const b2AABB& aabb, T fcn) const
+{
+	b2WorldQueryFunction<T> wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.fcn = &fcn;
+	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
+}
+
+template <typename T>
+inline void b2World::RayCast(const b2Vec2& point1, const b2Vec2& point2, T fcn) const
+{
+	b2WorldRayCastFunction<T> wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.fcn = &fcn;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+}
+
 #endif
@@ -24,9 +24,9 @@
 #define B2_WORLD_CALLBACKS_H
 
 #include "b2_api.h"
+#include "b2_math.h"
 #include "b2_settings.h"
 
-struct b2Vec2;
 struct b2Transform;
 class b2Fixture;
 class b2Body;
@@ -135,6 +135,66 @@ public:
 	virtual bool ReportFixture(b2Fixture* fixture) = 0;
 };
 
+/// A fixture found by a batched AABB query.
+/// See b2World::QueryAABBBatch
+struct B2_API b2QueryHit
+{
+	/// The index of the query AABB
+	int32 queryIndex;
+
+	/// The fixture that potentially overlaps the query AABB
+	b2Fixture* fixture;
+};
+
+/// The closest hit of a ray or shape cast. The fixture is nullptr if nothing was hit.
+/// See b2World::RayCastBatch, b2World::ShapeCast
+struct B2_API b2RayCastHit
+{
+	b2Fixture* fixture;
+	b2Vec2 point;
+	b2Vec2 normal;
+	float fraction;
+};
+
+/// A fixture found by a nearest query.
+/// See b2World::NearestFixture
+struct B2_API b2NearestHit
+{
+	/// The fixture
+	b2Fixture* fixture;
+
+	/// The closest point on the fixture
+	b2Vec2 point;
+
+	/// The distance from the query point. This is zero if the point is inside the fixture.
+	float distance;
+};
+
+/// A shape tested against the world by a batched overlap query.
+/// See b2World::OverlapShapeBatch
+struct B2_API b2ShapeQuery
+{
+	/// The query shape. Chain shapes use their first edge.
+	const b2Shape* shape;
+
+	/// The transform of the shape
+	b2Transform transform;
+};
+
+/// A shape swept through the world by a batched shape cast.
+/// See b2World::ShapeCastBatch
+struct B2_API b2ShapeCastQuery
+{
+	/// The swept shape. Chain shapes sweep their first edge.
+	const b2Shape* shape;
+
+	/// The starting transform of the shape
+	b2Transform transform;
+
+	/// The sweep translation
+	b2Vec2 translation;
+};
+
 /// Callback class for ray casts.
 /// See b2World::RayCast
 class B2_API b2RayCastCallback
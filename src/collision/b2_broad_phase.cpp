@@ -25,6 +25,8 @@
 
 b2BroadPhase::b2BroadPhase()
 {
+	m_type = b2_dynamicTreeBroadPhase;
+
 	m_proxyCount = 0;
 
 	m_pairCapacity = 16;
@@ -34,17 +36,50 @@ b2BroadPhase::b2BroadPhase()
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_layerCapacity = 16;
+	m_layers = (uint8*)b2Alloc(m_layerCapacity * sizeof(uint8));
+	memset(m_layers, 0, m_layerCapacity * sizeof(uint8));
+
+	for (int32 i = 0; i < b2_maxLayers; ++i)
+	{
+		m_layerMatrix[i] = ~uint64(0);
+	}
+
+	m_rejectedPairCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
 	b2Free(m_moveBuffer);
 	b2Free(m_pairBuffer);
+	b2Free(m_layers);
+}
+
+void b2BroadPhase::SetType(b2BroadPhaseType type)
+{
+	b2Assert(m_proxyCount == 0);
+	m_type = type;
+	m_moveCount = 0;
 }
 
 int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	int32 proxyId;
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		proxyId = m_sweepAndPrune.CreateProxy(aabb, userData);
+		break;
+
+	case b2_gridBroadPhase:
+		proxyId = m_grid.CreateProxy(aabb, userData);
+		break;
+
+	default:
+		proxyId = m_tree.CreateProxy(aabb, userData);
+	}
+
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
@@ -54,12 +89,45 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+
+	// The id may be reused by a proxy that never sets its layer.
+	if (proxyId < m_layerCapacity)
+	{
+		m_layers[proxyId] = 0;
+	}
+
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		m_sweepAndPrune.DestroyProxy(proxyId);
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.DestroyProxy(proxyId);
+		break;
+
+	default:
+		m_tree.DestroyProxy(proxyId);
+	}
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		buffer = m_sweepAndPrune.MoveProxy(proxyId, aabb, displacement);
+		break;
+
+	case b2_gridBroadPhase:
+		buffer = m_grid.MoveProxy(proxyId, aabb, displacement);
+		break;
+
+	default:
+		buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	}
+
 	if (buffer)
 	{
 		BufferMove(proxyId);
@@ -71,6 +139,59 @@ void b2BroadPhase::TouchProxy(int32 proxyId)
 	BufferMove(proxyId);
 }
 
+void b2BroadPhase::SetCategoryBits(int32 proxyId, uint16 categoryBits)
+{
+	if (m_type == b2_dynamicTreeBroadPhase)
+	{
+		m_tree.SetCategoryBits(proxyId, categoryBits);
+	}
+}
+
+void b2BroadPhase::SetLayer(int32 proxyId, uint8 layer)
+{
+	b2Assert(0 <= proxyId);
+	b2Assert(layer < b2_maxLayers);
+
+	if (proxyId >= m_layerCapacity)
+	{
+		if (layer == 0)
+		{
+			return;
+		}
+
+		int32 oldCapacity = m_layerCapacity;
+		while (m_layerCapacity <= proxyId)
+		{
+			m_layerCapacity *= 2;
+		}
+
+		uint8* oldLayers = m_layers;
+		m_layers = (uint8*)b2Alloc(m_layerCapacity * sizeof(uint8));
+		memcpy(m_layers, oldLayers, oldCapacity * sizeof(uint8));
+		memset(m_layers + oldCapacity, 0, (m_layerCapacity - oldCapacity) * sizeof(uint8));
+		b2Free(oldLayers);
+	}
+
+	m_layers[proxyId] = layer;
+}
+
+void b2BroadPhase::SetLayerCollision(int32 layerA, int32 layerB, bool flag)
+{
+	b2Assert(0 <= layerA && layerA < b2_maxLayers);
+	b2Assert(0 <= layerB && layerB < b2_maxLayers);
+
+	if (flag)
+	{
+		m_layerMatrix[layerA] |= uint64(1) << layerB;
+		m_layerMatrix[layerB] |= uint64(1) << layerA;
+	}
+	else
+	{
+		m_layerMatrix[layerA] &= ~(uint64(1) << layerB);
+		m_layerMatrix[layerB] &= ~(uint64(1) << layerA);
+	}
+}
+
 void b2BroadPhase::BufferMove(int32 proxyId)
 {
 	if (m_moveCount == m_moveCapacity)
@@ -97,7 +218,41 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 	}
 }
 
-// This is called from b2DynamicTree::Query when we are gathering pairs.
+void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		m_sweepAndPrune.ShiftOrigin(newOrigin);
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.ShiftOrigin(newOrigin);
+		break;
+
+	default:
+		m_tree.ShiftOrigin(newOrigin);
+	}
+}
+
+void b2BroadPhase::Relayout()
+{
+	switch (m_type)
+	{
+	case b2_sweepAndPruneBroadPhase:
+		// The sorted entry array is already contiguous.
+		break;
+
+	case b2_gridBroadPhase:
+		m_grid.Relayout();
+		break;
+
+	default:
+		m_tree.Relayout();
+	}
+}
+
+// This is called from the proxy structure's Query when we are gathering pairs.
 bool b2BroadPhase::QueryCallback(int32 proxyId)
 {
 	// A proxy cannot form a pair with itself.
@@ -106,13 +261,28 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 		return true;
 	}
 
-	const bool moved = m_tree.WasMoved(proxyId);
+	const bool moved = WasMoved(proxyId);
 	if (moved && proxyId > m_queryProxyId)
 	{
 		// Both proxies are moving. Avoid duplicate pairs.
 		return true;
 	}
 
+	BufferPair(proxyId, m_queryProxyId);
+
+	return true;
+}
+
+// This is called from b2SweepAndPrune::FindPairs and QueryCallback.
+void b2BroadPhase::BufferPair(int32 proxyIdA, int32 proxyIdB)
+{
+	// Pairs between layers that do not collide never reach the contact manager.
+	if ((m_layerMatrix[GetLayer(proxyIdA)] & (uint64(1) << GetLayer(proxyIdB))) == 0)
+	{
+		++m_rejectedPairCount;
+		return;
+	}
+
 	// Grow the pair buffer as needed.
 	if (m_pairCount == m_pairCapacity)
 	{
@@ -123,9 +293,7 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 		b2Free(oldBuffer);
 	}
 
-	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyId, m_queryProxyId);
-	m_pairBuffer[m_pairCount].proxyIdB = b2Max(proxyId, m_queryProxyId);
+	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyIdA, proxyIdB);
+	m_pairBuffer[m_pairCount].proxyIdB = b2Max(proxyIdA, proxyIdB);
 	++m_pairCount;
-
-	return true;
 }
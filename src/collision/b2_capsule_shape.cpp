@@ -0,0 +1,219 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_capsule_shape.h"
+#include "box2d/b2_block_allocator.h"
+
+#include <new>
+
+void b2CapsuleShape::Set(const b2Vec2& center1, const b2Vec2& center2, float radius)
+{
+	b2Assert(b2DistanceSquared(center1, center2) > b2_linearSlop * b2_linearSlop);
+	b2Assert(radius > 0.0f);
+
+	m_center1 = center1;
+	m_center2 = center2;
+	m_radius = radius;
+}
+
+b2Shape* b2CapsuleShape::Clone(b2BlockAllocator* allocator) const
+{
+	void* mem = allocator->Allocate(sizeof(b2CapsuleShape));
+	b2CapsuleShape* clone = new (mem) b2CapsuleShape;
+	*clone = *this;
+	return clone;
+}
+
+int32 b2CapsuleShape::GetChildCount() const
+{
+	return 1;
+}
+
+bool b2CapsuleShape::TestPoint(const b2Transform& transform, const b2Vec2& p) const
+{
+	b2Vec2 q = b2MulT(transform, p);
+
+	// Closest point on the segment.
+	b2Vec2 e = m_center2 - m_center1;
+	float t = b2Clamp(b2Dot(q - m_center1, e) / b2Dot(e, e), 0.0f, 1.0f);
+	b2Vec2 d = q - (m_center1 + t * e);
+	return b2Dot(d, d) <= m_radius * m_radius;
+}
+
+// Ray cast against one of the round ends. See b2CircleShape::RayCast.
+static bool b2RayCastRoundEnd(float* fraction, b2Vec2* normal,
+							  const b2Vec2& p1, const b2Vec2& d, float maxFraction,
+							  const b2Vec2& center, float radius)
+{
+	b2Vec2 s = p1 - center;
+	float b = b2Dot(s, s) - radius * radius;
+	float c = b2Dot(s, d);
+	float rr = b2Dot(d, d);
+	float sigma = c * c - rr * b;
+
+	if (sigma < 0.0f || rr < b2_epsilon)
+	{
+		return false;
+	}
+
+	float a = -(c + b2Sqrt(sigma));
+	if (0.0f <= a && a <= maxFraction * rr)
+	{
+		a /= rr;
+		*fraction = a;
+		*normal = s + a * d;
+		normal->Normalize();
+		return true;
+	}
+
+	return false;
+}
+
+// The ray is first cast against the two sides of the infinite capsule. If the hit point
+// lies beyond a center, the ray is cast against that round end instead.
+bool b2CapsuleShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
+							const b2Transform& transform, int32 childIndex) const
+{
+	B2_NOT_USED(childIndex);
+
+	// Put the ray into the capsule's frame of reference.
+	b2Vec2 p1 = b2MulT(transform.q, input.p1 - transform.p);
+	b2Vec2 p2 = b2MulT(transform.q, input.p2 - transform.p);
+	b2Vec2 d = p2 - p1;
+
+	b2Vec2 v1 = m_center1;
+	b2Vec2 v2 = m_center2;
+	b2Vec2 axis = v2 - v1;
+	float length = axis.Normalize();
+
+	// Ray start relative to the first center, split along and across the axis.
+	b2Vec2 q = p1 - v1;
+	float qa = b2Dot(q, axis);
+	b2Vec2 qp = q - qa * axis;
+
+	float fraction;
+	b2Vec2 normal;
+	bool hit;
+
+	if (b2Dot(qp, qp) < m_radius * m_radius)
+	{
+		// The ray starts between the sides. It can only hit a round end.
+		if (qa < 0.0f)
+		{
+			hit = b2RayCastRoundEnd(&fraction, &normal, p1, d, input.maxFraction, v1, m_radius);
+		}
+		else if (qa > length)
+		{
+			hit = b2RayCastRoundEnd(&fraction, &normal, p1, d, input.maxFraction, v2, m_radius);
+		}
+		else
+		{
+			// Starts inside the capsule.
+			hit = false;
+		}
+	}
+	else
+	{
+		// Side normal pointing towards the ray start.
+		normal = b2Cross(axis, 1.0f);
+		if (b2Dot(normal, qp) < 0.0f)
+		{
+			normal = -normal;
+		}
+
+		// dot(normal, q + t * d) = radius
+		float numerator = m_radius - b2Dot(normal, q);
+		float denominator = b2Dot(normal, d);
+		if (denominator >= 0.0f)
+		{
+			// Moving away from the side.
+			return false;
+		}
+
+		fraction = numerator / denominator;
+		if (fraction < 0.0f || input.maxFraction < fraction)
+		{
+			return false;
+		}
+
+		// Where along the axis does the ray hit the side?
+		float s = qa + fraction * b2Dot(d, axis);
+		if (s < 0.0f)
+		{
+			hit = b2RayCastRoundEnd(&fraction, &normal, p1, d, input.maxFraction, v1, m_radius);
+		}
+		else if (s > length)
+		{
+			hit = b2RayCastRoundEnd(&fraction, &normal, p1, d, input.maxFraction, v2, m_radius);
+		}
+		else
+		{
+			hit = true;
+		}
+	}
+
+	if (hit == false)
+	{
+		return false;
+	}
+
+	output->fraction = fraction;
+	output->normal = b2Mul(transform.q, normal);
+	return true;
+}
+
+void b2CapsuleShape::ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const
+{
+	B2_NOT_USED(childIndex);
+
+	b2Vec2 v1 = b2Mul(transform, m_center1);
+	b2Vec2 v2 = b2Mul(transform, m_center2);
+
+	b2Vec2 r(m_radius, m_radius);
+	aabb->lowerBound = b2Min(v1, v2) - r;
+	aabb->upperBound = b2Max(v1, v2) + r;
+}
+
+// The capsule is a rectangle plus two half circles. Each half circle has its centroid
+// 4 * r / (3 * pi) beyond its center, and the parallel axis theorem moves it out there.
+void b2CapsuleShape::ComputeMass(b2MassData* massData, float density) const
+{
+	float radius = m_radius;
+	float rr = radius * radius;
+	float length = b2Distance(m_center1, m_center2);
+	float ll = length * length;
+
+	float circleMass = density * b2_pi * rr;
+	float boxMass = density * 2.0f * radius * length;
+
+	massData->mass = circleMass + boxMass;
+	massData->center = 0.5f * (m_center1 + m_center2);
+
+	// Inertia of the two half circles about the capsule center.
+	float lc = 4.0f * radius / (3.0f * b2_pi);
+	float h = 0.5f * length;
+	float circleInertia = circleMass * (0.5f * rr + h * h + 2.0f * h * lc);
+	float boxInertia = boxMass * (4.0f * rr + ll) / 12.0f;
+
+	// inertia about the local origin
+	massData->I = circleInertia + boxInertia + massData->mass * b2Dot(massData->center, massData->center);
+}
@@ -37,9 +37,25 @@ void b2ChainShape::Clear()
 {
 	b2Free(m_vertices);
 	m_vertices = nullptr;
+	b2Free(m_normals);
+	m_normals = nullptr;
 	m_count = 0;
 }
 
+// Precompute the segment normals so the colliders don't normalize the ghost segments
+// for every contact.
+static b2Vec2* b2CreateChainNormals(const b2Vec2* vertices, int32 count, const b2Vec2& prevVertex, const b2Vec2& nextVertex)
+{
+	b2Vec2* normals = (b2Vec2*)b2Alloc((count + 1) * sizeof(b2Vec2));
+	normals[0] = b2ComputeSegmentNormal(prevVertex, vertices[0]);
+	for (int32 i = 1; i < count; ++i)
+	{
+		normals[i] = b2ComputeSegmentNormal(vertices[i - 1], vertices[i]);
+	}
+	normals[count] = b2ComputeSegmentNormal(vertices[count - 1], nextVertex);
+	return normals;
+}
+
 void b2ChainShape::CreateLoop(const b2Vec2* vertices, int32 count)
 {
 	b2Assert(m_vertices == nullptr && m_count == 0);
@@ -63,6 +79,7 @@ void b2ChainShape::CreateLoop(const b2Vec2* vertices, int32 count)
 	m_vertices[count] = m_vertices[0];
 	m_prevVertex = m_vertices[m_count - 2];
 	m_nextVertex = m_vertices[1];
+	m_normals = b2CreateChainNormals(m_vertices, m_count, m_prevVertex, m_nextVertex);
 }
 
 void b2ChainShape::CreateChain(const b2Vec2* vertices, int32 count,	const b2Vec2& prevVertex, const b2Vec2& nextVertex)
@@ -81,6 +98,7 @@ void b2ChainShape::CreateChain(const b2Vec2* vertices, int32 count,	const b2Vec2
 
 	m_prevVertex = prevVertex;
 	m_nextVertex = nextVertex;
+	m_normals = b2CreateChainNormals(m_vertices, m_count, m_prevVertex, m_nextVertex);
 }
 
 b2Shape* b2ChainShape::Clone(b2BlockAllocator* allocator) const
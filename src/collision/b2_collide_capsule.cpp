@@ -0,0 +1,309 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_collision.h"
+#include "box2d/b2_capsule_shape.h"
+#include "box2d/b2_circle_shape.h"
+#include "box2d/b2_distance.h"
+#include "box2d/b2_edge_shape.h"
+#include "box2d/b2_polygon_shape.h"
+
+// Capsules use closest points while their cores are apart. Once the contact normal is
+// close to a side normal, or the cores overlap, the capsule is treated as a two-sided
+// polygon with a radius and clipped like any other polygon.
+
+// Cores closer than this overlap and the normal comes from the separating axis test.
+#define b2_capsuleOverlapTolerance (0.1f * b2_linearSlop)
+
+// Sine of the angle below which a normal counts as a side normal (about 6 degrees).
+#define b2_capsuleSideTolerance 0.1f
+
+// Build a two-sided polygon from a segment so the polygon clipping can be reused.
+static void b2MakeSegmentPolygon(b2PolygonShape* polygon, const b2Vec2& v1, const b2Vec2& v2, float radius)
+{
+	b2Vec2 normal = b2Cross(v2 - v1, 1.0f);
+	normal.Normalize();
+
+	polygon->m_count = 2;
+	polygon->m_vertices[0] = v1;
+	polygon->m_vertices[1] = v2;
+	polygon->m_normals[0] = normal;
+	polygon->m_normals[1] = -normal;
+	polygon->m_centroid = 0.5f * (v1 + v2);
+	polygon->m_radius = radius;
+}
+
+void b2CollideCapsuleAndCircle(b2Manifold* manifold,
+							   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+							   const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Compute circle position in the frame of the capsule.
+	b2Vec2 c = b2MulT(xfA, b2Mul(xfB, circleB->m_p));
+
+	b2Vec2 v1 = capsuleA->m_center1;
+	b2Vec2 v2 = capsuleA->m_center2;
+	b2Vec2 e = v2 - v1;
+
+	// Projection of the circle center onto the axis, scaled by the axis length squared.
+	float u = b2Dot(c - v1, e);
+	float ee = b2Dot(e, e);
+
+	float radius = capsuleA->m_radius + circleB->m_radius;
+
+	b2ContactFeature cf;
+	cf.indexB = 0;
+	cf.typeB = b2ContactFeature::e_vertex;
+
+	// Round end regions
+	if (u <= 0.0f || u >= ee)
+	{
+		int32 index = u <= 0.0f ? 0 : 1;
+		b2Vec2 P = index == 0 ? v1 : v2;
+		b2Vec2 d = c - P;
+		if (b2Dot(d, d) > radius * radius)
+		{
+			return;
+		}
+
+		cf.indexA = uint8(index);
+		cf.typeA = b2ContactFeature::e_vertex;
+		manifold->pointCount = 1;
+		manifold->type = b2Manifold::e_circles;
+		manifold->localNormal.SetZero();
+		manifold->localPoint = P;
+		manifold->points[0].id.key = 0;
+		manifold->points[0].id.cf = cf;
+		manifold->points[0].localPoint = circleB->m_p;
+		return;
+	}
+
+	// Side region
+	b2Vec2 P = v1 + (u / ee) * e;
+	b2Vec2 d = c - P;
+	if (b2Dot(d, d) > radius * radius)
+	{
+		return;
+	}
+
+	b2Vec2 n = b2Cross(e, 1.0f);
+	if (b2Dot(n, d) < 0.0f)
+	{
+		n = -n;
+	}
+	n.Normalize();
+
+	cf.indexA = 0;
+	cf.typeA = b2ContactFeature::e_face;
+	manifold->pointCount = 1;
+	manifold->type = b2Manifold::e_faceA;
+	manifold->localNormal = n;
+	manifold->localPoint = v1;
+	manifold->points[0].id.key = 0;
+	manifold->points[0].id.cf = cf;
+	manifold->points[0].localPoint = circleB->m_p;
+}
+
+// Collide two rounded segments. The segment vertices are in the local frame of their shape.
+static void b2CollideSegments(b2Manifold* manifold,
+							  const b2Vec2& localA1, const b2Vec2& localA2, float radiusA, const b2Transform& xfA,
+							  const b2Vec2& localB1, const b2Vec2& localB2, float radiusB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Segment B in the frame of A.
+	b2Transform xf = b2MulT(xfA, xfB);
+	b2Vec2 p1 = localA1;
+	b2Vec2 q1 = b2Mul(xf, localB1);
+	b2Vec2 d1 = localA2 - localA1;
+	b2Vec2 d2 = b2Mul(xf, localB2) - q1;
+	b2Vec2 r = p1 - q1;
+
+	float dd1 = b2Dot(d1, d1);
+	float dd2 = b2Dot(d2, d2);
+	float rd1 = b2Dot(r, d1);
+	float rd2 = b2Dot(r, d2);
+	float d12 = b2Dot(d1, d2);
+
+	b2Assert(dd1 > 0.0f && dd2 > 0.0f);
+
+	// Closest points between the segments. See Real-Time Collision Detection
+	// by Christer Ericson, section 5.1.9. Parallel segments start at the first vertex of A.
+	float s = 0.0f;
+	float denominator = dd1 * dd2 - d12 * d12;
+	if (denominator > b2_epsilon * dd1 * dd2)
+	{
+		s = b2Clamp((d12 * rd2 - rd1 * dd2) / denominator, 0.0f, 1.0f);
+	}
+
+	float t = (d12 * s + rd2) / dd2;
+	if (t < 0.0f)
+	{
+		t = 0.0f;
+		s = b2Clamp(-rd1 / dd1, 0.0f, 1.0f);
+	}
+	else if (t > 1.0f)
+	{
+		t = 1.0f;
+		s = b2Clamp((d12 - rd1) / dd1, 0.0f, 1.0f);
+	}
+
+	b2Vec2 closestA = p1 + s * d1;
+	b2Vec2 closestB = q1 + t * d2;
+	float distanceSquared = b2DistanceSquared(closestA, closestB);
+
+	float radius = radiusA + radiusB;
+	if (distanceSquared > radius * radius)
+	{
+		return;
+	}
+
+	if (distanceSquared > b2_capsuleOverlapTolerance * b2_capsuleOverlapTolerance)
+	{
+		// Round end against round end, unless the normal is close to a side normal.
+		b2Vec2 normal = closestB - closestA;
+		normal.Normalize();
+
+		float axialA = b2Abs(b2Dot(normal, d1)) / b2Sqrt(dd1);
+		float axialB = b2Abs(b2Dot(normal, d2)) / b2Sqrt(dd2);
+		if (axialA > b2_capsuleSideTolerance && axialB > b2_capsuleSideTolerance)
+		{
+			// Both closest points are at a vertex because neither normal is a side normal.
+			int32 indexA = s < 0.5f ? 0 : 1;
+			int32 indexB = t < 0.5f ? 0 : 1;
+
+			manifold->pointCount = 1;
+			manifold->type = b2Manifold::e_circles;
+			manifold->localNormal.SetZero();
+			manifold->localPoint = indexA == 0 ? localA1 : localA2;
+			manifold->points[0].localPoint = indexB == 0 ? localB1 : localB2;
+			manifold->points[0].id.key = 0;
+			manifold->points[0].id.cf.indexA = uint8(indexA);
+			manifold->points[0].id.cf.indexB = uint8(indexB);
+			manifold->points[0].id.cf.typeA = b2ContactFeature::e_vertex;
+			manifold->points[0].id.cf.typeB = b2ContactFeature::e_vertex;
+			return;
+		}
+	}
+
+	b2PolygonShape polygonA, polygonB;
+	b2MakeSegmentPolygon(&polygonA, localA1, localA2, radiusA);
+	b2MakeSegmentPolygon(&polygonB, localB1, localB2, radiusB);
+	b2CollidePolygons(manifold, &polygonA, xfA, &polygonB, xfB);
+}
+
+void b2CollideCapsules(b2Manifold* manifold,
+					   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+					   const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	b2CollideSegments(manifold,
+					  capsuleA->m_center1, capsuleA->m_center2, capsuleA->m_radius, xfA,
+					  capsuleB->m_center1, capsuleB->m_center2, capsuleB->m_radius, xfB);
+}
+
+void b2CollidePolygonAndCapsule(b2Manifold* manifold,
+								const b2PolygonShape* polygonA, const b2Transform& xfA,
+								const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Closest points between the cores.
+	b2DistanceInput input;
+	input.proxyA.Set(polygonA->m_vertices, polygonA->m_count, polygonA->m_radius);
+	input.proxyB.Set(&capsuleB->m_center1, 2, capsuleB->m_radius);
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = false;
+
+	b2SimplexCache cache;
+	cache.count = 0;
+
+	b2DistanceOutput output;
+	b2Distance(&output, &cache, &input);
+
+	float radius = polygonA->m_radius + capsuleB->m_radius;
+	if (output.distance > radius)
+	{
+		return;
+	}
+
+	if (output.distance > b2_capsuleOverlapTolerance)
+	{
+		b2Vec2 normal = (1.0f / output.distance) * (output.pointB - output.pointA);
+
+		// Is the normal close to a polygon face normal?
+		b2Vec2 localNormal = b2MulT(xfA.q, normal);
+		float maxDot = -b2_maxFloat;
+		for (int32 i = 0; i < polygonA->m_count; ++i)
+		{
+			maxDot = b2Max(maxDot, b2Dot(polygonA->m_normals[i], localNormal));
+		}
+
+		// Is the normal close to a capsule side normal?
+		b2Vec2 axis = b2Mul(xfB.q, capsuleB->m_center2 - capsuleB->m_center1);
+		axis.Normalize();
+		float axialB = b2Abs(b2Dot(normal, axis));
+
+		// Cosine that matches b2_capsuleSideTolerance.
+		const float k_cosTolerance = 0.995f;
+		if (maxDot < k_cosTolerance && axialB > b2_capsuleSideTolerance)
+		{
+			// Polygon vertex against a round end.
+			manifold->pointCount = 1;
+			manifold->type = b2Manifold::e_circles;
+			manifold->localNormal.SetZero();
+			manifold->localPoint = b2MulT(xfA, output.pointA);
+			manifold->points[0].localPoint = b2MulT(xfB, output.pointB);
+			manifold->points[0].id.key = 0;
+			manifold->points[0].id.cf.indexA = cache.indexA[0];
+			manifold->points[0].id.cf.indexB = cache.indexB[0];
+			manifold->points[0].id.cf.typeA = b2ContactFeature::e_vertex;
+			manifold->points[0].id.cf.typeB = b2ContactFeature::e_vertex;
+			return;
+		}
+	}
+
+	b2PolygonShape polygonB;
+	b2MakeSegmentPolygon(&polygonB, capsuleB->m_center1, capsuleB->m_center2, capsuleB->m_radius);
+	b2CollidePolygons(manifold, polygonA, xfA, &polygonB, xfB);
+}
+
+void b2CollideEdgeAndCapsule(b2Manifold* manifold,
+							 const b2EdgeShape* edgeA, const b2Transform& xfA,
+							 const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	if (edgeA->m_oneSided == false)
+	{
+		// A two-sided edge is a thin capsule.
+		b2CollideSegments(manifold,
+						  edgeA->m_vertex1, edgeA->m_vertex2, edgeA->m_radius, xfA,
+						  capsuleB->m_center1, capsuleB->m_center2, capsuleB->m_radius, xfB);
+		return;
+	}
+
+	// One-sided edges need the adjacent vertices for smooth collision, which the
+	// edge and polygon collider handles.
+	b2PolygonShape polygonB;
+	b2MakeSegmentPolygon(&polygonB, capsuleB->m_center1, capsuleB->m_center2, capsuleB->m_radius);
+	b2CollideEdgeAndPolygon(manifold, edgeA, xfA, &polygonB, xfB);
+}
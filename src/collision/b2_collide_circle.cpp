@@ -71,20 +71,59 @@ void b2CollidePolygonAndCircle(
 	const b2Vec2* vertices = polygonA->m_vertices;
 	const b2Vec2* normals = polygonA->m_normals;
 
-	for (int32 i = 0; i < vertexCount; ++i)
+	if (b2_boxCollision && polygonA->m_isBox)
 	{
-		float s = b2Dot(normals[i], cLocal - vertices[i]);
+		// Closed form separation of the faces -y, +x, +y, -x.
+		b2Vec2 d = cLocal - polygonA->m_centroid;
+		b2Vec2 h = polygonA->GetBoxExtents();
+		float du = b2Dot(normals[1], d);
+		float dv = b2Dot(normals[2], d);
 
-		if (s > radius)
+		separation = -dv - h.y;
+
+		float s = du - h.x;
+		if (s > separation)
 		{
-			// Early out.
-			return;
+			separation = s;
+			normalIndex = 1;
+		}
+
+		s = dv - h.y;
+		if (s > separation)
+		{
+			separation = s;
+			normalIndex = 2;
 		}
 
+		s = -du - h.x;
 		if (s > separation)
 		{
 			separation = s;
-			normalIndex = i;
+			normalIndex = 3;
+		}
+
+		if (separation > radius)
+		{
+			return;
+		}
+	}
+	else
+	{
+		for (int32 i = 0; i < vertexCount; ++i)
+		{
+			float s = b2Dot(normals[i], cLocal - vertices[i]);
+
+			if (s > radius)
+			{
+				// Early out.
+				return;
+			}
+
+			if (s > separation)
+			{
+				separation = s;
+				normalIndex = i;
+			}
 		}
 	}
 
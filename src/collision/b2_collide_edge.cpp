@@ -21,10 +21,15 @@
 // SOFTWARE.
 
 #include "box2d/b2_collision.h"
+#include "box2d/b2_chain_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_edge_shape.h"
 #include "box2d/b2_polygon_shape.h"
 
+#if defined(B2_SSE2)
+#include <emmintrin.h>
+#endif
+
 
 // Compute contact points for edge versus circle.
 // This accounts for edge connectivity.
@@ -180,14 +185,6 @@ struct b2EPAxis
 	float separation;
 };
 
-// This holds polygon B expressed in frame A.
-struct b2TempPolygon
-{
-	b2Vec2 vertices[b2_maxPolygonVertices];
-	b2Vec2 normals[b2_maxPolygonVertices];
-	int32 count;
-};
-
 // Reference face used for clipping
 struct b2ReferenceFace
 {
@@ -202,73 +199,145 @@ struct b2ReferenceFace
 	float sideOffset2;
 };
 
-static b2EPAxis b2ComputeEdgeSeparation(const b2TempPolygon& polygonB, const b2Vec2& v1, const b2Vec2& normal1)
+// The separation of polygon B along the edge normal and along the polygon normals. The
+// polygon is moved into frame A one vertex at a time instead of copying it.
+struct b2EdgeSeparations
 {
-	b2EPAxis axis;
-	axis.type = b2EPAxis::e_edgeA;
-	axis.index = -1;
-	axis.separation = -FLT_MAX;
-	axis.normal.SetZero();
-
-	b2Vec2 axes[2] = { normal1, -normal1 };
+	float minEdgeSeparation;	// deepest vertex along the edge normal
+	float maxEdgeSeparation;	// shallowest vertex along the edge normal
+	float polygonSeparations[b2_maxPolygonVertices + 3];	// padded for SIMD stores
+};
 
-	// Find axis with least overlap (min-max problem)
-	for (int32 j = 0; j < 2; ++j)
+static void b2ComputeEdgeSeparationsScalar(b2EdgeSeparations* output,
+										   const b2PolygonShape* polygonB, const b2Transform& xf,
+										   const b2Vec2& v1, const b2Vec2& v2, const b2Vec2& normal1)
+{
+	float minSeparation = FLT_MAX;
+	float maxSeparation = -FLT_MAX;
+	for (int32 i = 0; i < polygonB->m_count; ++i)
 	{
-		float sj = FLT_MAX;
+		b2Vec2 v = b2Mul(xf, polygonB->m_vertices[i]);
+		b2Vec2 n = -b2Mul(xf.q, polygonB->m_normals[i]);
 
-		// Find deepest polygon vertex along axis j
-		for (int32 i = 0; i < polygonB.count; ++i)
+		float si = b2Dot(normal1, v - v1);
+		minSeparation = b2Min(minSeparation, si);
+		maxSeparation = b2Max(maxSeparation, si);
+
+		float s1 = b2Dot(n, v - v1);
+		float s2 = b2Dot(n, v - v2);
+		output->polygonSeparations[i] = b2Min(s1, s2);
+	}
+
+	output->minEdgeSeparation = minSeparation;
+	output->maxEdgeSeparation = maxSeparation;
+}
+
+#if defined(B2_SSE2)
+
+// Four polygon vertices at a time. The arithmetic matches the scalar version exactly.
+static void b2ComputeEdgeSeparationsSSE2(b2EdgeSeparations* output,
+										 const b2PolygonShape* polygonB, const b2Transform& xf,
+										 const b2Vec2& v1, const b2Vec2& v2, const b2Vec2& normal1)
+{
+	int32 count = polygonB->m_count;
+	const b2Vec2* vertices = polygonB->m_vertices;
+	const b2Vec2* normals = polygonB->m_normals;
+
+	__m128 c = _mm_set1_ps(xf.q.c);
+	__m128 s = _mm_set1_ps(xf.q.s);
+	__m128 px = _mm_set1_ps(xf.p.x);
+	__m128 py = _mm_set1_ps(xf.p.y);
+	__m128 v1x = _mm_set1_ps(v1.x);
+	__m128 v1y = _mm_set1_ps(v1.y);
+	__m128 v2x = _mm_set1_ps(v2.x);
+	__m128 v2y = _mm_set1_ps(v2.y);
+	__m128 n1x = _mm_set1_ps(normal1.x);
+	__m128 n1y = _mm_set1_ps(normal1.y);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	__m128 minSeparation = _mm_set1_ps(FLT_MAX);
+	__m128 maxSeparation = _mm_set1_ps(-FLT_MAX);
+	float* separations = output->polygonSeparations;
+
+	for (int32 i = 0; i < count; i += 4)
+	{
+		__m128 x, y, nx, ny;
+		if (i + 4 <= count)
 		{
-			float si = b2Dot(axes[j], polygonB.vertices[i] - v1);
-			if (si < sj)
-			{
-				sj = si;
-			}
+			// Split pairs of interleaved vertices into x and y.
+			__m128 a = _mm_loadu_ps(&vertices[i].x);
+			__m128 b = _mm_loadu_ps(&vertices[i + 2].x);
+			x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+			a = _mm_loadu_ps(&normals[i].x);
+			b = _mm_loadu_ps(&normals[i + 2].x);
+			nx = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			ny = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
 		}
-
-		if (sj > axis.separation)
+		else
 		{
-			axis.index = j;
-			axis.separation = sj;
-			axis.normal = axes[j];
+			// Repeat the last vertex. This doesn't change the min and max and the extra
+			// polygon separations are ignored.
+			int32 i1 = b2Min(i + 1, count - 1);
+			int32 i2 = b2Min(i + 2, count - 1);
+			int32 i3 = count - 1;
+			x = _mm_setr_ps(vertices[i].x, vertices[i1].x, vertices[i2].x, vertices[i3].x);
+			y = _mm_setr_ps(vertices[i].y, vertices[i1].y, vertices[i2].y, vertices[i3].y);
+			nx = _mm_setr_ps(normals[i].x, normals[i1].x, normals[i2].x, normals[i3].x);
+			ny = _mm_setr_ps(normals[i].y, normals[i1].y, normals[i2].y, normals[i3].y);
 		}
+
+		// Vertices and negated normals in frame A, as in b2Mul.
+		__m128 vx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, x), _mm_mul_ps(s, y)), px);
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, x), _mm_mul_ps(c, y)), py);
+		__m128 mx = _mm_xor_ps(_mm_sub_ps(_mm_mul_ps(c, nx), _mm_mul_ps(s, ny)), signMask);
+		__m128 my = _mm_xor_ps(_mm_add_ps(_mm_mul_ps(s, nx), _mm_mul_ps(c, ny)), signMask);
+
+		__m128 d1x = _mm_sub_ps(vx, v1x);
+		__m128 d1y = _mm_sub_ps(vy, v1y);
+		__m128 d2x = _mm_sub_ps(vx, v2x);
+		__m128 d2y = _mm_sub_ps(vy, v2y);
+
+		__m128 si = _mm_add_ps(_mm_mul_ps(n1x, d1x), _mm_mul_ps(n1y, d1y));
+		minSeparation = _mm_min_ps(minSeparation, si);
+		maxSeparation = _mm_max_ps(maxSeparation, si);
+
+		__m128 s1 = _mm_add_ps(_mm_mul_ps(mx, d1x), _mm_mul_ps(my, d1y));
+		__m128 s2 = _mm_add_ps(_mm_mul_ps(mx, d2x), _mm_mul_ps(my, d2y));
+		_mm_storeu_ps(separations + i, _mm_min_ps(s1, s2));
 	}
 
-	return axis;
+	float mins[4], maxs[4];
+	_mm_storeu_ps(mins, minSeparation);
+	_mm_storeu_ps(maxs, maxSeparation);
+	output->minEdgeSeparation = b2Min(b2Min(mins[0], mins[1]), b2Min(mins[2], mins[3]));
+	output->maxEdgeSeparation = b2Max(b2Max(maxs[0], maxs[1]), b2Max(maxs[2], maxs[3]));
 }
 
-static b2EPAxis b2ComputePolygonSeparation(const b2TempPolygon& polygonB, const b2Vec2& v1, const b2Vec2& v2)
-{
-	b2EPAxis axis;
-	axis.type = b2EPAxis::e_unknown;
-	axis.index = -1;
-	axis.separation = -FLT_MAX;
-	axis.normal.SetZero();
+#endif
 
-	for (int32 i = 0; i < polygonB.count; ++i)
+static void b2ComputeEdgeSeparations(b2EdgeSeparations* output,
+									 const b2PolygonShape* polygonB, const b2Transform& xf,
+									 const b2Vec2& v1, const b2Vec2& v2, const b2Vec2& normal1)
+{
+#if defined(B2_SSE2)
+	if (b2_simdCollision)
 	{
-		b2Vec2 n = -polygonB.normals[i];
-
-		float s1 = b2Dot(n, polygonB.vertices[i] - v1);
-		float s2 = b2Dot(n, polygonB.vertices[i] - v2);
-		float s = b2Min(s1, s2);
-
-		if (s > axis.separation)
-		{
-			axis.type = b2EPAxis::e_edgeB;
-			axis.index = i;
-			axis.separation = s;
-			axis.normal = n;
-		}
+		b2ComputeEdgeSeparationsSSE2(output, polygonB, xf, v1, v2, normal1);
+		return;
 	}
+#endif
 
-	return axis;
+	b2ComputeEdgeSeparationsScalar(output, polygonB, xf, v1, v2, normal1);
 }
 
-void b2CollideEdgeAndPolygon(b2Manifold* manifold,
-							const b2EdgeShape* edgeA, const b2Transform& xfA,
-							const b2PolygonShape* polygonB, const b2Transform& xfB)
+// The segment from v1 to v2 is in frame A. normals holds the unit normals of the previous
+// segment, this segment and the next segment. The neighbors are only used if one-sided.
+static void b2CollideSegmentAndPolygon(b2Manifold* manifold,
+									   const b2Vec2& v1, const b2Vec2& v2, const b2Vec2* normals,
+									   bool oneSided, float radiusA, const b2Transform& xfA,
+									   const b2PolygonShape* polygonB, const b2Transform& xfB)
 {
 	manifold->pointCount = 0;
 
@@ -276,45 +345,62 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 
 	b2Vec2 centroidB = b2Mul(xf, polygonB->m_centroid);
 
-	b2Vec2 v1 = edgeA->m_vertex1;
-	b2Vec2 v2 = edgeA->m_vertex2;
-
-	b2Vec2 edge1 = v2 - v1;
-	edge1.Normalize();
-
 	// Normal points to the right for a CCW winding
-	b2Vec2 normal1(edge1.y, -edge1.x);
+	b2Vec2 normal1 = normals[1];
+	b2Vec2 edge1(-normal1.y, normal1.x);
 	float offset1 = b2Dot(normal1, centroidB - v1);
 
-	bool oneSided = edgeA->m_oneSided;
 	if (oneSided && offset1 < 0.0f)
 	{
 		return;
 	}
 
-	// Get polygonB in frameA
-	b2TempPolygon tempPolygonB;
-	tempPolygonB.count = polygonB->m_count;
-	for (int32 i = 0; i < polygonB->m_count; ++i)
+	float radius = polygonB->m_radius + radiusA;
+
+	b2EdgeSeparations separations;
+	b2ComputeEdgeSeparations(&separations, polygonB, xf, v1, v2, normal1);
+
+	// Find axis with least overlap (min-max problem)
+	b2EPAxis edgeAxis;
+	edgeAxis.type = b2EPAxis::e_edgeA;
+	edgeAxis.index = 0;
+	edgeAxis.separation = separations.minEdgeSeparation;
+	edgeAxis.normal = normal1;
+	if (-separations.maxEdgeSeparation > edgeAxis.separation)
 	{
-		tempPolygonB.vertices[i] = b2Mul(xf, polygonB->m_vertices[i]);
-		tempPolygonB.normals[i] = b2Mul(xf.q, polygonB->m_normals[i]);
+		edgeAxis.index = 1;
+		edgeAxis.separation = -separations.maxEdgeSeparation;
+		edgeAxis.normal = -normal1;
 	}
 
-	float radius = polygonB->m_radius + edgeA->m_radius;
-
-	b2EPAxis edgeAxis = b2ComputeEdgeSeparation(tempPolygonB, v1, normal1);
 	if (edgeAxis.separation > radius)
 	{
 		return;
 	}
 
-	b2EPAxis polygonAxis = b2ComputePolygonSeparation(tempPolygonB, v1, v2);
+	b2EPAxis polygonAxis;
+	polygonAxis.type = b2EPAxis::e_unknown;
+	polygonAxis.index = -1;
+	polygonAxis.separation = -FLT_MAX;
+	polygonAxis.normal.SetZero();
+	for (int32 i = 0; i < polygonB->m_count; ++i)
+	{
+		float s = separations.polygonSeparations[i];
+		if (s > polygonAxis.separation)
+		{
+			polygonAxis.type = b2EPAxis::e_edgeB;
+			polygonAxis.index = i;
+			polygonAxis.separation = s;
+		}
+	}
+
 	if (polygonAxis.separation > radius)
 	{
 		return;
 	}
 
+	polygonAxis.normal = -b2Mul(xf.q, polygonB->m_normals[polygonAxis.index]);
+
 	// Use hysteresis for jitter reduction.
 	const float k_relativeTol = 0.98f;
 	const float k_absoluteTol = 0.001f;
@@ -334,14 +420,12 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 		// Smooth collision
 		// See https://box2d.org/posts/2020/06/ghost-collisions/
 
-		b2Vec2 edge0 = v1 - edgeA->m_vertex0;
-		edge0.Normalize();
-		b2Vec2 normal0(edge0.y, -edge0.x);
+		b2Vec2 normal0 = normals[0];
+		b2Vec2 edge0(-normal0.y, normal0.x);
 		bool convex1 = b2Cross(edge0, edge1) >= 0.0f;
 
-		b2Vec2 edge2 = edgeA->m_vertex3 - v2;
-		edge2.Normalize();
-		b2Vec2 normal2(edge2.y, -edge2.x);
+		b2Vec2 normal2 = normals[2];
+		b2Vec2 edge2(-normal2.y, normal2.x);
 		bool convex2 = b2Cross(edge1, edge2) >= 0.0f;
 
 		const float sinTol = 0.1f;
@@ -394,10 +478,10 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 
 		// Search for the polygon normal that is most anti-parallel to the edge normal.
 		int32 bestIndex = 0;
-		float bestValue = b2Dot(primaryAxis.normal, tempPolygonB.normals[0]);
-		for (int32 i = 1; i < tempPolygonB.count; ++i)
+		float bestValue = b2Dot(primaryAxis.normal, b2Mul(xf.q, polygonB->m_normals[0]));
+		for (int32 i = 1; i < polygonB->m_count; ++i)
 		{
-			float value = b2Dot(primaryAxis.normal, tempPolygonB.normals[i]);
+			float value = b2Dot(primaryAxis.normal, b2Mul(xf.q, polygonB->m_normals[i]));
 			if (value < bestValue)
 			{
 				bestValue = value;
@@ -406,15 +490,15 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 		}
 
 		int32 i1 = bestIndex;
-		int32 i2 = i1 + 1 < tempPolygonB.count ? i1 + 1 : 0;
+		int32 i2 = i1 + 1 < polygonB->m_count ? i1 + 1 : 0;
 
-		clipPoints[0].v = tempPolygonB.vertices[i1];
+		clipPoints[0].v = b2Mul(xf, polygonB->m_vertices[i1]);
 		clipPoints[0].id.cf.indexA = 0;
 		clipPoints[0].id.cf.indexB = static_cast<uint8>(i1);
 		clipPoints[0].id.cf.typeA = b2ContactFeature::e_face;
 		clipPoints[0].id.cf.typeB = b2ContactFeature::e_vertex;
 
-		clipPoints[1].v = tempPolygonB.vertices[i2];
+		clipPoints[1].v = b2Mul(xf, polygonB->m_vertices[i2]);
 		clipPoints[1].id.cf.indexA = 0;
 		clipPoints[1].id.cf.indexB = static_cast<uint8>(i2);
 		clipPoints[1].id.cf.typeA = b2ContactFeature::e_face;
@@ -445,10 +529,10 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 		clipPoints[1].id.cf.typeB = b2ContactFeature::e_face;
 
 		ref.i1 = primaryAxis.index;
-		ref.i2 = ref.i1 + 1 < tempPolygonB.count ? ref.i1 + 1 : 0;
-		ref.v1 = tempPolygonB.vertices[ref.i1];
-		ref.v2 = tempPolygonB.vertices[ref.i2];
-		ref.normal = tempPolygonB.normals[ref.i1];
+		ref.i2 = ref.i1 + 1 < polygonB->m_count ? ref.i1 + 1 : 0;
+		ref.v1 = b2Mul(xf, polygonB->m_vertices[ref.i1]);
+		ref.v2 = b2Mul(xf, polygonB->m_vertices[ref.i2]);
+		ref.normal = b2Mul(xf.q, polygonB->m_normals[ref.i1]);
 
 		// CCW winding
 		ref.sideNormal1.Set(ref.normal.y, -ref.normal.x);
@@ -522,3 +606,37 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 
 	manifold->pointCount = pointCount;
 }
+
+void b2CollideEdgeAndPolygon(b2Manifold* manifold,
+							const b2EdgeShape* edgeA, const b2Transform& xfA,
+							const b2PolygonShape* polygonB, const b2Transform& xfB)
+{
+	b2Vec2 v1 = edgeA->m_vertex1;
+	b2Vec2 v2 = edgeA->m_vertex2;
+
+	b2Vec2 normals[3];
+	normals[1] = b2ComputeSegmentNormal(v1, v2);
+	if (edgeA->m_oneSided)
+	{
+		normals[0] = b2ComputeSegmentNormal(edgeA->m_vertex0, v1);
+		normals[2] = b2ComputeSegmentNormal(v2, edgeA->m_vertex3);
+	}
+	else
+	{
+		normals[0].SetZero();
+		normals[2].SetZero();
+	}
+
+	b2CollideSegmentAndPolygon(manifold, v1, v2, normals, edgeA->m_oneSided, edgeA->m_radius, xfA, polygonB, xfB);
+}
+
+void b2CollideChainAndPolygon(b2Manifold* manifold,
+							  const b2ChainShape* chainA, int32 indexA, const b2Transform& xfA,
+							  const b2PolygonShape* polygonB, const b2Transform& xfB)
+{
+	b2Assert(0 <= indexA && indexA < chainA->m_count - 1);
+
+	// Chain segments are one-sided.
+	b2CollideSegmentAndPolygon(manifold, chainA->m_vertices[indexA], chainA->m_vertices[indexA + 1],
+							   chainA->m_normals + indexA, true, chainA->m_radius, xfA, polygonB, xfB);
+}
@@ -21,15 +21,34 @@
 // SOFTWARE.
 
 #include "box2d/b2_collision.h"
+#include "box2d/b2_distance.h"
 #include "box2d/b2_polygon_shape.h"
 
+#if defined(B2_SSE2)
+#include <emmintrin.h>
+#endif
+
+bool b2_simdCollision = true;
+bool b2_boxCollision = true;
+bool b2_hillClimbCollision = true;
+
+// The kernels below are templates on the vertex counts so the loops have a fixed trip
+// count and unroll. A count of zero means the count is read from the polygon.
+template <int32 N>
+static inline int32 b2GetVertexCount(const b2PolygonShape* poly)
+{
+	b2Assert(N == 0 || poly->m_count == N);
+	return N > 0 ? N : poly->m_count;
+}
+
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
-static float b2FindMaxSeparation(int32* edgeIndex,
+template <int32 N1, int32 N2>
+static float b2FindMaxSeparationScalar(int32* edgeIndex,
 								 const b2PolygonShape* poly1, const b2Transform& xf1,
 								 const b2PolygonShape* poly2, const b2Transform& xf2)
 {
-	int32 count1 = poly1->m_count;
-	int32 count2 = poly2->m_count;
+	int32 count1 = b2GetVertexCount<N1>(poly1);
+	int32 count2 = b2GetVertexCount<N2>(poly2);
 	const b2Vec2* n1s = poly1->m_normals;
 	const b2Vec2* v1s = poly1->m_vertices;
 	const b2Vec2* v2s = poly2->m_vertices;
@@ -65,13 +84,112 @@ static float b2FindMaxSeparation(int32* edgeIndex,
 	return maxSeparation;
 }
 
+#if defined(B2_SSE2)
+
+// This tests four normals of poly1 against each vertex of poly2 at once. The arithmetic
+// matches the scalar version exactly, so both produce the same edge and separation.
+template <int32 N1, int32 N2>
+static float b2FindMaxSeparationSSE2(int32* edgeIndex,
+									 const b2PolygonShape* poly1, const b2Transform& xf1,
+									 const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	const int32 k_capacity = N1 > 0 ? (N1 + 3) & ~3 : (b2_maxPolygonVertices + 3) & ~3;
+
+	int32 count1 = b2GetVertexCount<N1>(poly1);
+	int32 count2 = b2GetVertexCount<N2>(poly2);
+
+	// Only fill the lanes that are loaded, not the whole capacity.
+	int32 paddedCount = (count1 + 3) & ~3;
+	const b2Vec2* n1s = poly1->m_normals;
+	const b2Vec2* v1s = poly1->m_vertices;
+	const b2Vec2* v2s = poly2->m_vertices;
+	b2Transform xf = b2MulT(xf2, xf1);
+
+	// Poly1 normals and vertices in frame2, in structure of arrays form.
+	float nx[k_capacity], ny[k_capacity];
+	float vx[k_capacity], vy[k_capacity];
+	float separations[k_capacity];
+	for (int32 i = 0; i < paddedCount; ++i)
+	{
+		if (i < count1)
+		{
+			b2Vec2 n = b2Mul(xf.q, n1s[i]);
+			b2Vec2 v1 = b2Mul(xf, v1s[i]);
+			nx[i] = n.x;
+			ny[i] = n.y;
+			vx[i] = v1.x;
+			vy[i] = v1.y;
+		}
+		else
+		{
+			nx[i] = 0.0f;
+			ny[i] = 0.0f;
+			vx[i] = 0.0f;
+			vy[i] = 0.0f;
+		}
+	}
+
+	for (int32 i = 0; i < paddedCount; i += 4)
+	{
+		__m128 nX = _mm_loadu_ps(nx + i);
+		__m128 nY = _mm_loadu_ps(ny + i);
+		__m128 v1X = _mm_loadu_ps(vx + i);
+		__m128 v1Y = _mm_loadu_ps(vy + i);
+
+		// Find deepest point for normals i to i + 3.
+		__m128 si = _mm_set1_ps(b2_maxFloat);
+		for (int32 j = 0; j < count2; ++j)
+		{
+			__m128 dX = _mm_sub_ps(_mm_set1_ps(v2s[j].x), v1X);
+			__m128 dY = _mm_sub_ps(_mm_set1_ps(v2s[j].y), v1Y);
+			__m128 sij = _mm_add_ps(_mm_mul_ps(nX, dX), _mm_mul_ps(nY, dY));
+			si = _mm_min_ps(si, sij);
+		}
+
+		_mm_storeu_ps(separations + i, si);
+	}
+
+	// The first normal wins ties, as in the scalar version.
+	int32 bestIndex = 0;
+	float maxSeparation = -b2_maxFloat;
+	for (int32 i = 0; i < count1; ++i)
+	{
+		if (separations[i] > maxSeparation)
+		{
+			maxSeparation = separations[i];
+			bestIndex = i;
+		}
+	}
+
+	*edgeIndex = bestIndex;
+	return maxSeparation;
+}
+
+#endif
+
+template <int32 N1, int32 N2>
+static float b2FindMaxSeparation(int32* edgeIndex,
+								 const b2PolygonShape* poly1, const b2Transform& xf1,
+								 const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+#if defined(B2_SSE2)
+	if (b2_simdCollision)
+	{
+		return b2FindMaxSeparationSSE2<N1, N2>(edgeIndex, poly1, xf1, poly2, xf2);
+	}
+#endif
+
+	return b2FindMaxSeparationScalar<N1, N2>(edgeIndex, poly1, xf1, poly2, xf2);
+}
+
+template <int32 N2>
 static void b2FindIncidentEdge(b2ClipVertex c[2],
 							 const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1,
 							 const b2PolygonShape* poly2, const b2Transform& xf2)
 {
 	const b2Vec2* normals1 = poly1->m_normals;
 
-	int32 count2 = poly2->m_count;
+	int32 count2 = b2GetVertexCount<N2>(poly2);
 	const b2Vec2* vertices2 = poly2->m_vertices;
 	const b2Vec2* normals2 = poly2->m_normals;
 
@@ -110,6 +228,201 @@ static void b2FindIncidentEdge(b2ClipVertex c[2],
 	c[1].id.cf.typeB = b2ContactFeature::e_vertex;
 }
 
+// Find the max separation between box1 and box2 using the faces of box1. This is the
+// separating axis test of two boxes in closed form. The faces are ordered as made by
+// SetAsBox: -y, +x, +y, -x.
+static float b2FindMaxBoxSeparation(int32* edgeIndex,
+									const b2PolygonShape* box1, const b2Transform& xf1,
+									const b2PolygonShape* box2, const b2Transform& xf2)
+{
+	// Box2 in the frame of box1.
+	b2Transform xf = b2MulT(xf1, xf2);
+	b2Vec2 d = b2Mul(xf, box2->m_centroid) - box1->m_centroid;
+	b2Vec2 u2 = b2Mul(xf.q, box2->m_normals[1]);
+	b2Vec2 v2 = b2Mul(xf.q, box2->m_normals[2]);
+
+	b2Vec2 u1 = box1->m_normals[1];
+	b2Vec2 v1 = box1->m_normals[2];
+	b2Vec2 h1 = box1->GetBoxExtents();
+	b2Vec2 h2 = box2->GetBoxExtents();
+
+	// Center offset and box2 extent along the box1 axes.
+	float du = b2Dot(u1, d);
+	float dv = b2Dot(v1, d);
+	float eu = h2.x * b2Abs(b2Dot(u1, u2)) + h2.y * b2Abs(b2Dot(u1, v2));
+	float ev = h2.x * b2Abs(b2Dot(v1, u2)) + h2.y * b2Abs(b2Dot(v1, v2));
+
+	// The first face wins ties, as in b2FindMaxSeparation.
+	int32 bestIndex = 0;
+	float maxSeparation = -dv - h1.y - ev;
+
+	float s = du - h1.x - eu;
+	if (s > maxSeparation)
+	{
+		maxSeparation = s;
+		bestIndex = 1;
+	}
+
+	s = dv - h1.y - ev;
+	if (s > maxSeparation)
+	{
+		maxSeparation = s;
+		bestIndex = 2;
+	}
+
+	s = -du - h1.x - eu;
+	if (s > maxSeparation)
+	{
+		maxSeparation = s;
+		bestIndex = 3;
+	}
+
+	*edgeIndex = bestIndex;
+	return maxSeparation;
+}
+
+// Find the incident edge of box2. Opposite box normals are exact negatives of each
+// other, so two dot products give the same choice as b2FindIncidentEdge.
+static void b2FindIncidentBoxEdge(b2ClipVertex c[2],
+								  const b2PolygonShape* box1, const b2Transform& xf1, int32 edge1,
+								  const b2PolygonShape* box2, const b2Transform& xf2)
+{
+	const b2Vec2* vertices2 = box2->m_vertices;
+	const b2Vec2* normals2 = box2->m_normals;
+
+	// Get the normal of the reference edge in box2's frame.
+	b2Vec2 normal1 = b2MulT(xf2.q, b2Mul(xf1.q, box1->m_normals[edge1]));
+
+	float du = b2Dot(normal1, normals2[1]);
+	float dv = b2Dot(normal1, normals2[2]);
+
+	int32 index = 0;
+	float minDot = -dv;
+	if (du < minDot)
+	{
+		minDot = du;
+		index = 1;
+	}
+
+	if (dv < minDot)
+	{
+		minDot = dv;
+		index = 2;
+	}
+
+	if (-du < minDot)
+	{
+		index = 3;
+	}
+
+	int32 i1 = index;
+	int32 i2 = (index + 1) & 3;
+
+	c[0].v = b2Mul(xf2, vertices2[i1]);
+	c[0].id.cf.indexA = (uint8)edge1;
+	c[0].id.cf.indexB = (uint8)i1;
+	c[0].id.cf.typeA = b2ContactFeature::e_face;
+	c[0].id.cf.typeB = b2ContactFeature::e_vertex;
+
+	c[1].v = b2Mul(xf2, vertices2[i2]);
+	c[1].id.cf.indexA = (uint8)edge1;
+	c[1].id.cf.indexB = (uint8)i2;
+	c[1].id.cf.typeA = b2ContactFeature::e_face;
+	c[1].id.cf.typeB = b2ContactFeature::e_vertex;
+}
+
+// Find the max separation between two polygons where one has many vertices. The deepest
+// vertex of poly2 for a normal of poly1 is the support vertex in the opposite direction.
+// The normals of poly1 turn in order, so each support search starts from the previous one
+// and all normals take O(count1 + count2) steps instead of O(count1 * count2). The deepest
+// vertex for the chosen edge is returned for b2FindIncidentLargeEdge.
+static float b2FindMaxLargeSeparation(int32* edgeIndex, int32* vertexIndex,
+									  const b2PolygonShape* poly1, const b2Transform& xf1,
+									  const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	int32 count1 = poly1->m_count;
+	const b2Vec2* n1s = poly1->m_normals;
+	const b2Vec2* v1s = poly1->m_vertices;
+	const b2Vec2* v2s = poly2->m_vertices;
+	b2Transform xf = b2MulT(xf2, xf1);
+
+	int32 count2 = poly2->m_count;
+	b2DistanceProxy proxy2;
+	proxy2.SetConvex(v2s, count2, poly2->m_radius);
+
+	int32 bestIndex = 0;
+	int32 bestVertex = 0;
+	int32 vertex = proxy2.GetSupport(-b2Mul(xf.q, n1s[0]));
+	float maxSeparation = -b2_maxFloat;
+	for (int32 i = 0; i < count1; ++i)
+	{
+		// Get poly1 normal in frame2.
+		b2Vec2 n = b2Mul(xf.q, n1s[i]);
+		b2Vec2 v1 = b2Mul(xf, v1s[i]);
+
+		// Find deepest point for normal i. The normals turn counter-clockwise, so the
+		// deepest point only moves forward. Equal values are passed to get over a flat top.
+		float value = b2Dot(n, v2s[vertex]);
+		for (int32 j = 0; j < count2; ++j)
+		{
+			int32 next = vertex + 1 < count2 ? vertex + 1 : 0;
+			float nextValue = b2Dot(n, v2s[next]);
+			if (nextValue > value)
+			{
+				break;
+			}
+
+			vertex = next;
+			value = nextValue;
+		}
+
+		float si = value - b2Dot(n, v1);
+
+		if (si > maxSeparation)
+		{
+			maxSeparation = si;
+			bestIndex = i;
+			bestVertex = vertex;
+		}
+	}
+
+	*edgeIndex = bestIndex;
+	*vertexIndex = bestVertex;
+	return maxSeparation;
+}
+
+// Find the incident edge of a polygon with many vertices. The most anti-parallel normal
+// belongs to one of the two edges at the deepest vertex.
+static void b2FindIncidentLargeEdge(b2ClipVertex c[2],
+									const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1,
+									const b2PolygonShape* poly2, const b2Transform& xf2, int32 vertex2)
+{
+	int32 count2 = poly2->m_count;
+	const b2Vec2* vertices2 = poly2->m_vertices;
+	const b2Vec2* normals2 = poly2->m_normals;
+
+	b2Assert(0 <= vertex2 && vertex2 < count2);
+
+	// Get the normal of the reference edge in poly2's frame.
+	b2Vec2 normal1 = b2MulT(xf2.q, b2Mul(xf1.q, poly1->m_normals[edge1]));
+
+	int32 prev = vertex2 > 0 ? vertex2 - 1 : count2 - 1;
+	int32 i1 = b2Dot(normal1, normals2[prev]) < b2Dot(normal1, normals2[vertex2]) ? prev : vertex2;
+	int32 i2 = i1 + 1 < count2 ? i1 + 1 : 0;
+
+	c[0].v = b2Mul(xf2, vertices2[i1]);
+	c[0].id.cf.indexA = (uint8)edge1;
+	c[0].id.cf.indexB = (uint8)i1;
+	c[0].id.cf.typeA = b2ContactFeature::e_face;
+	c[0].id.cf.typeB = b2ContactFeature::e_vertex;
+
+	c[1].v = b2Mul(xf2, vertices2[i2]);
+	c[1].id.cf.indexA = (uint8)edge1;
+	c[1].id.cf.indexB = (uint8)i2;
+	c[1].id.cf.typeA = b2ContactFeature::e_face;
+	c[1].id.cf.typeB = b2ContactFeature::e_vertex;
+}
+
 // Find edge normal of max separation on A - return if separating axis is found
 // Find edge normal of max separation on B - return if separation axis is found
 // Choose reference edge as min(minA, minB)
@@ -117,20 +430,55 @@ static void b2FindIncidentEdge(b2ClipVertex c[2],
 // Clip
 
 // The normal points from 1 to 2
-void b2CollidePolygons(b2Manifold* manifold,
-					  const b2PolygonShape* polyA, const b2Transform& xfA,
-					  const b2PolygonShape* polyB, const b2Transform& xfB)
+template <int32 NA, int32 NB>
+static void b2CollidePolygonsN(b2Manifold* manifold,
+							   const b2PolygonShape* polyA, const b2Transform& xfA,
+							   const b2PolygonShape* polyB, const b2Transform& xfB)
 {
 	manifold->pointCount = 0;
 	float totalRadius = polyA->m_radius + polyB->m_radius;
 
+	bool boxes = b2_boxCollision && polyA->m_isBox && polyB->m_isBox;
+
+	// The specialized counts are all small.
+	bool large = NA == 0 && NB == 0 && b2_hillClimbCollision && boxes == false &&
+		(polyA->m_count > b2_hillClimbVertexCount || polyB->m_count > b2_hillClimbVertexCount);
+
 	int32 edgeA = 0;
-	float separationA = b2FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB);
+	int32 vertexB = 0;
+	float separationA;
+	if (boxes)
+	{
+		separationA = b2FindMaxBoxSeparation(&edgeA, polyA, xfA, polyB, xfB);
+	}
+	else if (large)
+	{
+		separationA = b2FindMaxLargeSeparation(&edgeA, &vertexB, polyA, xfA, polyB, xfB);
+	}
+	else
+	{
+		separationA = b2FindMaxSeparation<NA, NB>(&edgeA, polyA, xfA, polyB, xfB);
+	}
+
 	if (separationA > totalRadius)
 		return;
 
 	int32 edgeB = 0;
-	float separationB = b2FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA);
+	int32 vertexA = 0;
+	float separationB;
+	if (boxes)
+	{
+		separationB = b2FindMaxBoxSeparation(&edgeB, polyB, xfB, polyA, xfA);
+	}
+	else if (large)
+	{
+		separationB = b2FindMaxLargeSeparation(&edgeB, &vertexA, polyB, xfB, polyA, xfA);
+	}
+	else
+	{
+		separationB = b2FindMaxSeparation<NB, NA>(&edgeB, polyB, xfB, polyA, xfA);
+	}
+
 	if (separationB > totalRadius)
 		return;
 
@@ -163,7 +511,22 @@ void b2CollidePolygons(b2Manifold* manifold,
 	}
 
 	b2ClipVertex incidentEdge[2];
-	b2FindIncidentEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+	if (boxes)
+	{
+		b2FindIncidentBoxEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+	}
+	else if (large)
+	{
+		b2FindIncidentLargeEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2, flip ? vertexA : vertexB);
+	}
+	else if (flip)
+	{
+		b2FindIncidentEdge<NA>(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+	}
+	else
+	{
+		b2FindIncidentEdge<NB>(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+	}
 
 	int32 count1 = poly1->m_count;
 	const b2Vec2* vertices1 = poly1->m_vertices;
@@ -241,3 +604,46 @@ void b2CollidePolygons(b2Manifold* manifold,
 
 	manifold->pointCount = pointCount;
 }
+
+void b2CollidePolygons(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2Transform& xfA,
+					  const b2PolygonShape* polyB, const b2Transform& xfB)
+{
+	b2CollidePolygonsN<0, 0>(manifold, polyA, xfA, polyB, xfB);
+}
+
+// Maps a vertex count to a row in the collider table. Only triangles, quads and
+// octagons are specialized.
+static int32 b2GetColliderIndex(int32 count)
+{
+	switch (count)
+	{
+	case 3:
+		return 0;
+	case 4:
+		return 1;
+	case 8:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+b2CollidePolygonsFcn* b2GetPolygonCollider(int32 countA, int32 countB)
+{
+	static b2CollidePolygonsFcn* const s_colliders[3][3] =
+	{
+		{ b2CollidePolygonsN<3, 3>, b2CollidePolygonsN<3, 4>, b2CollidePolygonsN<3, 8> },
+		{ b2CollidePolygonsN<4, 3>, b2CollidePolygonsN<4, 4>, b2CollidePolygonsN<4, 8> },
+		{ b2CollidePolygonsN<8, 3>, b2CollidePolygonsN<8, 4>, b2CollidePolygonsN<8, 8> }
+	};
+
+	int32 indexA = b2GetColliderIndex(countA);
+	int32 indexB = b2GetColliderIndex(countB);
+	if (indexA < 0 || indexB < 0)
+	{
+		return b2CollidePolygons;
+	}
+
+	return s_colliders[indexA][indexB];
+}
@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_distance.h"
 #include "box2d/b2_edge_shape.h"
@@ -27,7 +28,6 @@
 #include "box2d/b2_polygon_shape.h"
 
 // GJK using Voronoi regions (Christer Ericson) and Barycentric coordinates.
-B2_API int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
 
 void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 {
@@ -45,9 +45,7 @@ void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 	case b2Shape::e_polygon:
 		{
 			const b2PolygonShape* polygon = static_cast<const b2PolygonShape*>(shape);
-			m_vertices = polygon->m_vertices;
-			m_count = polygon->m_count;
-			m_radius = polygon->m_radius;
+			SetConvex(polygon->m_vertices, polygon->m_count, polygon->m_radius);
 		}
 		break;
 
@@ -81,6 +79,15 @@ void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			const b2CapsuleShape* capsule = static_cast<const b2CapsuleShape*>(shape);
+			m_vertices = &capsule->m_center1;
+			m_count = 2;
+			m_radius = capsule->m_radius;
+		}
+		break;
+
 	default:
 		b2Assert(false);
 	}
@@ -91,6 +98,86 @@ void b2DistanceProxy::Set(const b2Vec2* vertices, int32 count, float radius)
     m_vertices = vertices;
     m_count = count;
     m_radius = radius;
+    m_convex = false;
+}
+
+void b2DistanceProxy::SetConvex(const b2Vec2* vertices, int32 count, float radius)
+{
+	m_vertices = vertices;
+	m_count = count;
+	m_radius = radius;
+	m_convex = true;
+}
+
+// The dot product with d rises from the minimum to the maximum on both sides of a convex
+// polygon, so walking uphill from any vertex ends at the maximum. Only a flat minimum
+// has no uphill neighbor and that falls back to testing every vertex.
+int32 b2DistanceProxy::ClimbSupport(const b2Vec2& d, int32 start) const
+{
+	b2Assert(0 <= start && start < m_count);
+
+	int32 bestIndex = start;
+	float bestValue = b2Dot(m_vertices[start], d);
+
+	int32 next = start + 1 < m_count ? start + 1 : 0;
+	int32 prev = start > 0 ? start - 1 : m_count - 1;
+	float nextValue = b2Dot(m_vertices[next], d);
+	float prevValue = b2Dot(m_vertices[prev], d);
+
+	// Step is +1 or -1 modulo the count.
+	int32 step;
+	if (nextValue > bestValue)
+	{
+		step = 1;
+		bestIndex = next;
+		bestValue = nextValue;
+	}
+	else if (prevValue > bestValue)
+	{
+		step = m_count - 1;
+		bestIndex = prev;
+		bestValue = prevValue;
+	}
+	else if (nextValue < bestValue && prevValue < bestValue)
+	{
+		return start;
+	}
+	else
+	{
+		bestIndex = 0;
+		bestValue = b2Dot(m_vertices[0], d);
+		for (int32 i = 1; i < m_count; ++i)
+		{
+			float value = b2Dot(m_vertices[i], d);
+			if (value > bestValue)
+			{
+				bestIndex = i;
+				bestValue = value;
+			}
+		}
+
+		return bestIndex;
+	}
+
+	for (int32 i = 2; i < m_count; ++i)
+	{
+		int32 index = bestIndex + step;
+		if (index >= m_count)
+		{
+			index -= m_count;
+		}
+
+		float value = b2Dot(m_vertices[index], d);
+		if (value <= bestValue)
+		{
+			break;
+		}
+
+		bestIndex = index;
+		bestValue = value;
+	}
+
+	return bestIndex;
 }
 
 struct b2SimplexVertex
@@ -455,8 +542,6 @@ void b2Distance(b2DistanceOutput* output,
 				b2SimplexCache* cache,
 				const b2DistanceInput* input)
 {
-	++b2_gjkCalls;
-
 	const b2DistanceProxy* proxyA = &input->proxyA;
 	const b2DistanceProxy* proxyB = &input->proxyB;
 
@@ -526,17 +611,18 @@ void b2Distance(b2DistanceOutput* output,
 			break;
 		}
 
-		// Compute a tentative new simplex vertex using support points.
+		// Compute a tentative new simplex vertex using support points. The search
+		// starts at the newest simplex vertex, which is close for large polygons.
 		b2SimplexVertex* vertex = vertices + simplex.m_count;
-		vertex->indexA = proxyA->GetSupport(b2MulT(transformA.q, -d));
+		const b2SimplexVertex* last = vertex - 1;
+		vertex->indexA = proxyA->GetSupport(b2MulT(transformA.q, -d), last->indexA);
 		vertex->wA = b2Mul(transformA, proxyA->GetVertex(vertex->indexA));
-		vertex->indexB = proxyB->GetSupport(b2MulT(transformB.q, d));
+		vertex->indexB = proxyB->GetSupport(b2MulT(transformB.q, d), last->indexB);
 		vertex->wB = b2Mul(transformB, proxyB->GetVertex(vertex->indexB));
 		vertex->w = vertex->wB - vertex->wA;
 
 		// Iteration count is equated to the number of support point calls.
 		++iter;
-		++b2_gjkIters;
 
 		// Check for duplicate support points. This is the main termination criteria.
 		bool duplicate = false;
@@ -559,8 +645,6 @@ void b2Distance(b2DistanceOutput* output,
 		++simplex.m_count;
 	}
 
-	b2_gjkMaxIters = b2Max(b2_gjkMaxIters, iter);
-
 	// Prepare output.
 	simplex.GetWitnessPoints(&output->pointA, &output->pointB);
 	output->distance = b2Distance(output->pointA, output->pointB);
@@ -647,9 +731,9 @@ bool b2ShapeCast(b2ShapeCastOutput * output, const b2ShapeCastInput * input)
         output->iterations += 1;
 
 		// Support in direction -v (A - B)
-		indexA = proxyA->GetSupport(b2MulT(xfA.q, -v));
+		indexA = proxyA->GetSupport(b2MulT(xfA.q, -v), indexA);
 		wA = b2Mul(xfA, proxyA->GetVertex(indexA));
-		indexB = proxyB->GetSupport(b2MulT(xfB.q, v));
+		indexB = proxyB->GetSupport(b2MulT(xfB.q, v), indexB);
 		wB = b2Mul(xfB, proxyB->GetVertex(indexB));
         b2Vec2 p = wA - wB;
 
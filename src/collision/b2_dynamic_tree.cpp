@@ -22,6 +22,8 @@
 #include "box2d/b2_dynamic_tree.h"
 #include <string.h>
 
+static_assert(sizeof(b2TreeNode) == 32, "tree nodes should pack two to a cache line");
+
 b2DynamicTree::b2DynamicTree()
 {
 	m_root = b2_nullNode;
@@ -41,6 +43,20 @@ b2DynamicTree::b2DynamicTree()
 	m_nodes[m_nodeCapacity-1].height = -1;
 	m_freeList = 0;
 
+	m_proxyCapacity = 16;
+	m_proxyNodes = (int32*)b2Alloc(m_proxyCapacity * sizeof(int32));
+	m_userData = (void**)b2Alloc(m_proxyCapacity * sizeof(void*));
+	memset(m_userData, 0, m_proxyCapacity * sizeof(void*));
+	m_moved = (bool*)b2Alloc(m_proxyCapacity * sizeof(bool));
+	memset(m_moved, 0, m_proxyCapacity * sizeof(bool));
+
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxyNodes[i] = i + 1;
+	}
+	m_proxyNodes[m_proxyCapacity-1] = b2_nullNode;
+	m_proxyFreeList = 0;
+
 	m_insertionCount = 0;
 }
 
@@ -48,6 +64,9 @@ b2DynamicTree::~b2DynamicTree()
 {
 	// This frees the entire tree in one shot.
 	b2Free(m_nodes);
+	b2Free(m_proxyNodes);
+	b2Free(m_userData);
+	b2Free(m_moved);
 }
 
 // Allocate a node from the pool. Grow the pool if necessary.
@@ -84,8 +103,7 @@ int32 b2DynamicTree::AllocateNode()
 	m_nodes[nodeId].child1 = b2_nullNode;
 	m_nodes[nodeId].child2 = b2_nullNode;
 	m_nodes[nodeId].height = 0;
-	m_nodes[nodeId].userData = nullptr;
-	m_nodes[nodeId].moved = false;
+	m_nodes[nodeId].categoryBits = 0;
 	++m_nodeCount;
 	return nodeId;
 }
@@ -101,97 +119,139 @@ void b2DynamicTree::FreeNode(int32 nodeId)
 	--m_nodeCount;
 }
 
-// Create a proxy in the tree as a leaf node. We return the index
-// of the node instead of a pointer so that we can grow
-// the node pool.
+// Allocate a proxy id. Grow the proxy arrays if necessary.
+int32 b2DynamicTree::AllocateProxy()
+{
+	if (m_proxyFreeList == b2_nullNode)
+	{
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity *= 2;
+
+		int32* oldProxyNodes = m_proxyNodes;
+		m_proxyNodes = (int32*)b2Alloc(m_proxyCapacity * sizeof(int32));
+		memcpy(m_proxyNodes, oldProxyNodes, oldCapacity * sizeof(int32));
+		b2Free(oldProxyNodes);
+
+		void** oldUserData = m_userData;
+		m_userData = (void**)b2Alloc(m_proxyCapacity * sizeof(void*));
+		memcpy(m_userData, oldUserData, oldCapacity * sizeof(void*));
+		memset(m_userData + oldCapacity, 0, (m_proxyCapacity - oldCapacity) * sizeof(void*));
+		b2Free(oldUserData);
+
+		bool* oldMoved = m_moved;
+		m_moved = (bool*)b2Alloc(m_proxyCapacity * sizeof(bool));
+		memcpy(m_moved, oldMoved, oldCapacity * sizeof(bool));
+		memset(m_moved + oldCapacity, 0, (m_proxyCapacity - oldCapacity) * sizeof(bool));
+		b2Free(oldMoved);
+
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxyNodes[i] = i + 1;
+		}
+		m_proxyNodes[m_proxyCapacity-1] = b2_nullNode;
+		m_proxyFreeList = oldCapacity;
+	}
+
+	int32 proxyId = m_proxyFreeList;
+	m_proxyFreeList = m_proxyNodes[proxyId];
+	return proxyId;
+}
+
+// Return a proxy id to the pool.
+void b2DynamicTree::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxyNodes[proxyId] = m_proxyFreeList;
+	m_userData[proxyId] = nullptr;
+	m_moved[proxyId] = false;
+	m_proxyFreeList = proxyId;
+}
+
+// Create a proxy in the tree as a leaf node. We return a proxy id
+// instead of a pointer or node index so that we can grow and
+// reorder the node pool.
 int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 {
-	int32 proxyId = AllocateNode();
+	int32 proxyId = AllocateProxy();
+	int32 nodeId = AllocateNode();
 
 	// Fatten the aabb.
 	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
-	m_nodes[proxyId].aabb.lowerBound = aabb.lowerBound - r;
-	m_nodes[proxyId].aabb.upperBound = aabb.upperBound + r;
-	m_nodes[proxyId].userData = userData;
-	m_nodes[proxyId].height = 0;
-	m_nodes[proxyId].moved = true;
+	m_nodes[nodeId].aabb.lowerBound = aabb.lowerBound - r;
+	m_nodes[nodeId].aabb.upperBound = aabb.upperBound + r;
+	m_nodes[nodeId].proxyId = proxyId;
+	m_nodes[nodeId].height = 0;
+	m_nodes[nodeId].categoryBits = 0xFFFF;
+
+	m_proxyNodes[proxyId] = nodeId;
+	m_userData[proxyId] = userData;
+	m_moved[proxyId] = true;
 
-	InsertLeaf(proxyId);
+	InsertLeaf(nodeId);
 
 	return proxyId;
 }
 
 void b2DynamicTree::DestroyProxy(int32 proxyId)
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	b2Assert(m_nodes[proxyId].IsLeaf());
-
-	RemoveLeaf(proxyId);
-	FreeNode(proxyId);
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	int32 nodeId = m_proxyNodes[proxyId];
+	b2Assert(m_nodes[nodeId].IsLeaf());
+	b2Assert(m_nodes[nodeId].proxyId == proxyId);
+
+	RemoveLeaf(nodeId);
+	FreeNode(nodeId);
+	FreeProxy(proxyId);
 }
 
 bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	int32 nodeId = m_proxyNodes[proxyId];
 
-	b2Assert(m_nodes[proxyId].IsLeaf());
+	b2Assert(m_nodes[nodeId].IsLeaf());
 
-	// Extend AABB
-	b2AABB fatAABB;
-	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
-	fatAABB.lowerBound = aabb.lowerBound - r;
-	fatAABB.upperBound = aabb.upperBound + r;
-
-	// Predict AABB movement
-	b2Vec2 d = b2_aabbMultiplier * displacement;
+	b2AABB fatAABB = b2ComputeFatAABB(aabb, displacement);
 
-	if (d.x < 0.0f)
-	{
-		fatAABB.lowerBound.x += d.x;
-	}
-	else
+	if (b2NeedsFatAABBUpdate(m_nodes[nodeId].aabb, aabb, fatAABB) == false)
 	{
-		fatAABB.upperBound.x += d.x;
+		// No tree update needed.
+		return false;
 	}
 
-	if (d.y < 0.0f)
-	{
-		fatAABB.lowerBound.y += d.y;
-	}
-	else
-	{
-		fatAABB.upperBound.y += d.y;
-	}
+	RemoveLeaf(nodeId);
 
-	const b2AABB& treeAABB = m_nodes[proxyId].aabb;
-	if (treeAABB.Contains(aabb))
-	{
-		// The tree AABB still contains the object, but it might be too large.
-		// Perhaps the object was moving fast but has since gone to sleep.
-		// The huge AABB is larger than the new fat AABB.
-		b2AABB hugeAABB;
-		hugeAABB.lowerBound = fatAABB.lowerBound - 4.0f * r;
-		hugeAABB.upperBound = fatAABB.upperBound + 4.0f * r;
+	m_nodes[nodeId].aabb = fatAABB;
 
-		if (hugeAABB.Contains(treeAABB))
-		{
-			// The tree AABB contains the object AABB and the tree AABB is
-			// not too large. No tree update needed.
-			return false;
-		}
+	InsertLeaf(nodeId);
 
-		// Otherwise the tree AABB is huge and needs to be shrunk
-	}
+	m_moved[proxyId] = true;
 
-	RemoveLeaf(proxyId);
+	return true;
+}
 
-	m_nodes[proxyId].aabb = fatAABB;
+void b2DynamicTree::SetCategoryBits(int32 proxyId, uint16 categoryBits)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	int32 index = m_proxyNodes[proxyId];
+	b2Assert(m_nodes[index].IsLeaf());
 
-	InsertLeaf(proxyId);
+	m_nodes[index].categoryBits = categoryBits;
 
-	m_nodes[proxyId].moved = true;
+	// Update the ancestors until the combined bits stop changing.
+	index = m_nodes[index].parent;
+	while (index != b2_nullNode)
+	{
+		b2TreeNode* node = m_nodes + index;
+		uint16 bits = m_nodes[node->child1].categoryBits | m_nodes[node->child2].categoryBits;
+		if (bits == node->categoryBits)
+		{
+			break;
+		}
 
-	return true;
+		node->categoryBits = bits;
+		index = node->parent;
+	}
 }
 
 void b2DynamicTree::InsertLeaf(int32 leaf)
@@ -282,9 +342,9 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 	int32 oldParent = m_nodes[sibling].parent;
 	int32 newParent = AllocateNode();
 	m_nodes[newParent].parent = oldParent;
-	m_nodes[newParent].userData = nullptr;
 	m_nodes[newParent].aabb.Combine(leafAABB, m_nodes[sibling].aabb);
 	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].categoryBits = m_nodes[leaf].categoryBits | m_nodes[sibling].categoryBits;
 
 	if (oldParent != b2_nullNode)
 	{
@@ -327,6 +387,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 		m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
 		m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+		m_nodes[index].categoryBits = m_nodes[child1].categoryBits | m_nodes[child2].categoryBits;
 
 		index = m_nodes[index].parent;
 	}
@@ -379,6 +440,7 @@ void b2DynamicTree::RemoveLeaf(int32 leaf)
 
 			m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
 			m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
+			m_nodes[index].categoryBits = m_nodes[child1].categoryBits | m_nodes[child2].categoryBits;
 
 			index = m_nodes[index].parent;
 		}
@@ -456,6 +518,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			G->parent = iA;
 			A->aabb.Combine(B->aabb, G->aabb);
 			C->aabb.Combine(A->aabb, F->aabb);
+			A->categoryBits = B->categoryBits | G->categoryBits;
+			C->categoryBits = A->categoryBits | F->categoryBits;
 
 			A->height = 1 + b2Max(B->height, G->height);
 			C->height = 1 + b2Max(A->height, F->height);
@@ -467,6 +531,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			F->parent = iA;
 			A->aabb.Combine(B->aabb, F->aabb);
 			C->aabb.Combine(A->aabb, G->aabb);
+			A->categoryBits = B->categoryBits | F->categoryBits;
+			C->categoryBits = A->categoryBits | G->categoryBits;
 
 			A->height = 1 + b2Max(B->height, F->height);
 			C->height = 1 + b2Max(A->height, G->height);
@@ -516,6 +582,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			E->parent = iA;
 			A->aabb.Combine(C->aabb, E->aabb);
 			B->aabb.Combine(A->aabb, D->aabb);
+			A->categoryBits = C->categoryBits | E->categoryBits;
+			B->categoryBits = A->categoryBits | D->categoryBits;
 
 			A->height = 1 + b2Max(C->height, E->height);
 			B->height = 1 + b2Max(A->height, D->height);
@@ -527,6 +595,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			D->parent = iA;
 			A->aabb.Combine(C->aabb, D->aabb);
 			B->aabb.Combine(A->aabb, E->aabb);
+			A->categoryBits = C->categoryBits | D->categoryBits;
+			B->categoryBits = A->categoryBits | E->categoryBits;
 
 			A->height = 1 + b2Max(C->height, D->height);
 			B->height = 1 + b2Max(A->height, E->height);
@@ -616,9 +686,9 @@ void b2DynamicTree::ValidateStructure(int32 index) const
 
 	if (node->IsLeaf())
 	{
-		b2Assert(child1 == b2_nullNode);
-		b2Assert(child2 == b2_nullNode);
 		b2Assert(node->height == 0);
+		b2Assert(0 <= node->proxyId && node->proxyId < m_proxyCapacity);
+		b2Assert(m_proxyNodes[node->proxyId] == index);
 		return;
 	}
 
@@ -646,8 +716,6 @@ void b2DynamicTree::ValidateMetrics(int32 index) const
 
 	if (node->IsLeaf())
 	{
-		b2Assert(child1 == b2_nullNode);
-		b2Assert(child2 == b2_nullNode);
 		b2Assert(node->height == 0);
 		return;
 	}
@@ -666,6 +734,7 @@ void b2DynamicTree::ValidateMetrics(int32 index) const
 
 	b2Assert(aabb.lowerBound == node->aabb.lowerBound);
 	b2Assert(aabb.upperBound == node->aabb.upperBound);
+	b2Assert(node->categoryBits == (m_nodes[child1].categoryBits | m_nodes[child2].categoryBits));
 
 	ValidateMetrics(child1);
 	ValidateMetrics(child2);
@@ -774,6 +843,7 @@ void b2DynamicTree::RebuildBottomUp()
 		parent->child2 = index2;
 		parent->height = 1 + b2Max(child1->height, child2->height);
 		parent->aabb.Combine(child1->aabb, child2->aabb);
+		parent->categoryBits = child1->categoryBits | child2->categoryBits;
 		parent->parent = b2_nullNode;
 
 		child1->parent = parentIndex;
@@ -790,6 +860,88 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+void b2DynamicTree::Relayout()
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// Number the nodes in the depth-first order used by the queries. A parent is
+	// followed by its first child and the whole first subtree.
+	int32* remap = (int32*)b2Alloc(m_nodeCapacity * sizeof(int32));
+	int32 count = 0;
+
+	int32 previousId = b2_nullNode;
+	int32 nodeId = m_root;
+	while (nodeId != b2_nullNode)
+	{
+		const b2TreeNode* node = m_nodes + nodeId;
+		int32 nextId = node->parent;
+
+		if (previousId == node->parent)
+		{
+			remap[nodeId] = count;
+			++count;
+
+			if (node->IsLeaf() == false)
+			{
+				nextId = node->child1;
+			}
+		}
+		else if (previousId == node->child1)
+		{
+			nextId = node->child2;
+		}
+
+		previousId = nodeId;
+		nodeId = nextId;
+	}
+
+	b2Assert(count == m_nodeCount);
+
+	b2TreeNode* nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		const b2TreeNode* node = m_nodes + i;
+		if (node->height < 0)
+		{
+			// Free node in pool
+			continue;
+		}
+
+		b2TreeNode* newNode = nodes + remap[i];
+		*newNode = *node;
+		newNode->parent = node->parent == b2_nullNode ? b2_nullNode : remap[node->parent];
+
+		if (node->IsLeaf())
+		{
+			m_proxyNodes[node->proxyId] = remap[i];
+		}
+		else
+		{
+			newNode->child1 = remap[node->child1];
+			newNode->child2 = remap[node->child2];
+		}
+	}
+
+	// Rebuild the free list after the live nodes.
+	memset(nodes + count, 0, (m_nodeCapacity - count) * sizeof(b2TreeNode));
+	for (int32 i = count; i < m_nodeCapacity; ++i)
+	{
+		nodes[i].next = i + 1 < m_nodeCapacity ? i + 1 : b2_nullNode;
+		nodes[i].height = -1;
+	}
+	m_freeList = count < m_nodeCapacity ? count : b2_nullNode;
+
+	b2Free(m_nodes);
+	b2Free(remap);
+	m_nodes = nodes;
+	m_root = 0;
+
+	Validate();
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	// Build array of leaves. Free the rest.
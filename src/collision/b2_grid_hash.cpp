@@ -0,0 +1,384 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_grid_hash.h"
+#include <string.h>
+
+b2GridHash::b2GridHash()
+{
+	m_cellSize = b2_gridCellSize;
+	m_inverseCellSize = 1.0f / m_cellSize;
+
+	m_proxies = nullptr;
+	m_proxyCount = 0;
+	m_proxyCapacity = 0;
+	m_freeList = b2_nullNode;
+
+	m_entries = nullptr;
+	m_entryCount = 0;
+	m_entryCapacity = 0;
+	m_freeEntry = b2_nullNode;
+
+	m_buckets = nullptr;
+	m_bucketCount = 0;
+
+	m_oversizedCount = 0;
+}
+
+b2GridHash::~b2GridHash()
+{
+	b2Free(m_buckets);
+	b2Free(m_entries);
+	b2Free(m_proxies);
+}
+
+void b2GridHash::SetCellSize(float cellSize)
+{
+	b2Assert(m_proxyCount == 0);
+	b2Assert(cellSize > 0.0f);
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.0f / cellSize;
+}
+
+// Allocate a proxy from the pool. Grow the pool if necessary.
+int32 b2GridHash::AllocateProxy()
+{
+	if (m_freeList == b2_nullNode)
+	{
+		b2Assert(m_proxyCount == m_proxyCapacity);
+
+		// The free list is empty. Rebuild a bigger pool.
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity = oldCapacity == 0 ? 16 : 2 * oldCapacity;
+
+		b2GridProxy* oldProxies = m_proxies;
+		m_proxies = (b2GridProxy*)b2Alloc(m_proxyCapacity * sizeof(b2GridProxy));
+		if (oldProxies != nullptr)
+		{
+			memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2GridProxy));
+			b2Free(oldProxies);
+		}
+
+		// Build a linked list for the free list.
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].allocated = false;
+		}
+		m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+		m_proxies[m_proxyCapacity - 1].allocated = false;
+		m_freeList = oldCapacity;
+	}
+
+	// Peel a proxy off the free list.
+	int32 proxyId = m_freeList;
+	m_freeList = m_proxies[proxyId].next;
+	m_proxies[proxyId].userData = nullptr;
+	m_proxies[proxyId].treeProxyId = b2_nullNode;
+	m_proxies[proxyId].allocated = true;
+	m_proxies[proxyId].moved = false;
+	++m_proxyCount;
+	return proxyId;
+}
+
+// Return a proxy to the pool.
+void b2GridHash::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(0 < m_proxyCount);
+	m_proxies[proxyId].next = m_freeList;
+	m_proxies[proxyId].allocated = false;
+	m_freeList = proxyId;
+	--m_proxyCount;
+}
+
+// Allocate a cell entry from the pool. Grow the pool if necessary.
+int32 b2GridHash::AllocateEntry()
+{
+	if (m_freeEntry == b2_nullNode)
+	{
+		b2Assert(m_entryCount == m_entryCapacity);
+
+		int32 oldCapacity = m_entryCapacity;
+		m_entryCapacity = oldCapacity == 0 ? 64 : 2 * oldCapacity;
+
+		b2GridEntry* oldEntries = m_entries;
+		m_entries = (b2GridEntry*)b2Alloc(m_entryCapacity * sizeof(b2GridEntry));
+		if (oldEntries != nullptr)
+		{
+			memcpy(m_entries, oldEntries, oldCapacity * sizeof(b2GridEntry));
+			b2Free(oldEntries);
+		}
+
+		for (int32 i = oldCapacity; i < m_entryCapacity - 1; ++i)
+		{
+			m_entries[i].next = i + 1;
+			m_entries[i].proxyId = b2_nullNode;
+		}
+		m_entries[m_entryCapacity - 1].next = b2_nullNode;
+		m_entries[m_entryCapacity - 1].proxyId = b2_nullNode;
+		m_freeEntry = oldCapacity;
+	}
+
+	int32 entryId = m_freeEntry;
+	m_freeEntry = m_entries[entryId].next;
+	++m_entryCount;
+	return entryId;
+}
+
+void b2GridHash::FreeEntry(int32 entryId)
+{
+	b2Assert(0 <= entryId && entryId < m_entryCapacity);
+	b2Assert(0 < m_entryCount);
+	m_entries[entryId].next = m_freeEntry;
+	m_entries[entryId].proxyId = b2_nullNode;
+	m_freeEntry = entryId;
+	--m_entryCount;
+}
+
+// Rebuild the bucket lists. Entries keep their cell coordinates.
+void b2GridHash::Rehash(int32 bucketCount)
+{
+	b2Assert((bucketCount & (bucketCount - 1)) == 0);
+
+	b2Free(m_buckets);
+	m_bucketCount = bucketCount;
+	m_buckets = (int32*)b2Alloc(m_bucketCount * sizeof(int32));
+	for (int32 i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = b2_nullNode;
+	}
+
+	for (int32 i = 0; i < m_entryCapacity; ++i)
+	{
+		b2GridEntry* entry = m_entries + i;
+		if (entry->proxyId == b2_nullNode)
+		{
+			continue;
+		}
+
+		int32 bucket = GetBucket(entry->cellX, entry->cellY);
+		entry->next = m_buckets[bucket];
+		m_buckets[bucket] = i;
+	}
+}
+
+// Put a proxy into the grid or into the oversized tree, based on its fat AABB.
+void b2GridHash::InsertProxy(int32 proxyId)
+{
+	b2GridProxy* proxy = m_proxies + proxyId;
+	const b2AABB& aabb = proxy->aabb;
+
+	proxy->lowerX = GetCell(aabb.lowerBound.x);
+	proxy->lowerY = GetCell(aabb.lowerBound.y);
+	proxy->upperX = GetCell(aabb.upperBound.x);
+	proxy->upperY = GetCell(aabb.upperBound.y);
+
+	if (proxy->upperX - proxy->lowerX >= e_maxSpan || proxy->upperY - proxy->lowerY >= e_maxSpan)
+	{
+		// The tree fattens the AABB again, so it always contains the proxy AABB.
+		proxy->treeProxyId = m_tree.CreateProxy(aabb, (void*)uintptr_t(proxyId));
+		++m_oversizedCount;
+		return;
+	}
+
+	proxy->treeProxyId = b2_nullNode;
+
+	int32 cellCount = (proxy->upperX - proxy->lowerX + 1) * (proxy->upperY - proxy->lowerY + 1);
+	if (m_entryCount + cellCount > m_bucketCount)
+	{
+		// Keep the load factor at or below one.
+		int32 bucketCount = m_bucketCount == 0 ? 64 : m_bucketCount;
+		while (bucketCount < m_entryCount + cellCount)
+		{
+			bucketCount *= 2;
+		}
+
+		Rehash(bucketCount);
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			int32 entryId = AllocateEntry();
+			b2GridEntry* entry = m_entries + entryId;
+			entry->cellX = x;
+			entry->cellY = y;
+			entry->proxyId = proxyId;
+
+			int32 bucket = GetBucket(x, y);
+			entry->next = m_buckets[bucket];
+			m_buckets[bucket] = entryId;
+		}
+	}
+}
+
+void b2GridHash::RemoveProxy(int32 proxyId)
+{
+	b2GridProxy* proxy = m_proxies + proxyId;
+
+	if (proxy->treeProxyId != b2_nullNode)
+	{
+		m_tree.DestroyProxy(proxy->treeProxyId);
+		proxy->treeProxyId = b2_nullNode;
+		--m_oversizedCount;
+		return;
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			// Unlink the entry for this cell.
+			int32* link = m_buckets + GetBucket(x, y);
+			while (*link != b2_nullNode)
+			{
+				b2GridEntry* entry = m_entries + *link;
+				if (entry->proxyId == proxyId && entry->cellX == x && entry->cellY == y)
+				{
+					int32 entryId = *link;
+					*link = entry->next;
+					FreeEntry(entryId);
+					break;
+				}
+
+				link = &entry->next;
+			}
+		}
+	}
+}
+
+int32 b2GridHash::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId = AllocateProxy();
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2GridProxy* proxy = m_proxies + proxyId;
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->moved = true;
+
+	InsertProxy(proxyId);
+
+	return proxyId;
+}
+
+void b2GridHash::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	RemoveProxy(proxyId);
+	FreeProxy(proxyId);
+}
+
+bool b2GridHash::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	b2GridProxy* proxy = m_proxies + proxyId;
+	b2AABB fatAABB = b2ComputeFatAABB(aabb, displacement);
+
+	if (b2NeedsFatAABBUpdate(proxy->aabb, aabb, fatAABB) == false)
+	{
+		return false;
+	}
+
+	proxy->aabb = fatAABB;
+	proxy->moved = true;
+
+	// Most moves stay within the same cells.
+	bool sameCells = proxy->treeProxyId == b2_nullNode;
+	sameCells = sameCells && proxy->lowerX == GetCell(fatAABB.lowerBound.x);
+	sameCells = sameCells && proxy->lowerY == GetCell(fatAABB.lowerBound.y);
+	sameCells = sameCells && proxy->upperX == GetCell(fatAABB.upperBound.x);
+	sameCells = sameCells && proxy->upperY == GetCell(fatAABB.upperBound.y);
+	if (sameCells)
+	{
+		return true;
+	}
+
+	RemoveProxy(proxyId);
+	InsertProxy(proxyId);
+
+	return true;
+}
+
+void b2GridHash::Validate() const
+{
+#if defined(b2DEBUG)
+	int32 entryCount = 0;
+	for (int32 bucket = 0; bucket < m_bucketCount; ++bucket)
+	{
+		int32 entryId = m_buckets[bucket];
+		while (entryId != b2_nullNode)
+		{
+			const b2GridEntry* entry = m_entries + entryId;
+			b2Assert(GetBucket(entry->cellX, entry->cellY) == bucket);
+
+			const b2GridProxy* proxy = m_proxies + entry->proxyId;
+			b2Assert(proxy->allocated);
+			b2Assert(proxy->treeProxyId == b2_nullNode);
+			b2Assert(proxy->lowerX <= entry->cellX && entry->cellX <= proxy->upperX);
+			b2Assert(proxy->lowerY <= entry->cellY && entry->cellY <= proxy->upperY);
+
+			++entryCount;
+			entryId = entry->next;
+		}
+	}
+	b2Assert(entryCount == m_entryCount);
+
+	int32 oversizedCount = 0;
+	for (int32 i = 0; i < m_proxyCapacity; ++i)
+	{
+		if (m_proxies[i].allocated && m_proxies[i].treeProxyId != b2_nullNode)
+		{
+			++oversizedCount;
+		}
+	}
+	b2Assert(oversizedCount == m_oversizedCount);
+
+	m_tree.Validate();
+#endif
+}
+
+void b2GridHash::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// Cell coordinates change, so all proxies are hashed again.
+	for (int32 i = 0; i < m_proxyCapacity; ++i)
+	{
+		b2GridProxy* proxy = m_proxies + i;
+		if (proxy->allocated == false)
+		{
+			continue;
+		}
+
+		RemoveProxy(i);
+		proxy->aabb.lowerBound -= newOrigin;
+		proxy->aabb.upperBound -= newOrigin;
+		InsertProxy(i);
+	}
+}
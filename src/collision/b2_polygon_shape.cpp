@@ -45,6 +45,7 @@ void b2PolygonShape::SetAsBox(float hx, float hy)
 	m_normals[2].Set(0.0f, 1.0f);
 	m_normals[3].Set(-1.0f, 0.0f);
 	m_centroid.SetZero();
+	m_isBox = true;
 }
 
 void b2PolygonShape::SetAsBox(float hx, float hy, const b2Vec2& center, float angle)
@@ -59,6 +60,7 @@ void b2PolygonShape::SetAsBox(float hx, float hy, const b2Vec2& center, float an
 	m_normals[2].Set(0.0f, 1.0f);
 	m_normals[3].Set(-1.0f, 0.0f);
 	m_centroid = center;
+	m_isBox = true;
 
 	b2Transform xf;
 	xf.p = center;
@@ -225,6 +227,7 @@ void b2PolygonShape::Set(const b2Vec2* vertices, int32 count)
 	}
 
 	m_count = m;
+	m_isBox = false;
 
 	// Copy vertices.
 	for (int32 i = 0; i < m; ++i)
@@ -0,0 +1,239 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_sweep_and_prune.h"
+#include <string.h>
+
+b2SweepAndPrune::b2SweepAndPrune()
+{
+	m_proxies = nullptr;
+	m_proxyCount = 0;
+	m_proxyCapacity = 0;
+	m_freeList = b2_nullNode;
+
+	m_entries = nullptr;
+	m_active = nullptr;
+
+	m_maxExtent = 0.0f;
+}
+
+b2SweepAndPrune::~b2SweepAndPrune()
+{
+	b2Free(m_active);
+	b2Free(m_entries);
+	b2Free(m_proxies);
+}
+
+// Allocate a proxy from the pool. Grow the pool if necessary.
+int32 b2SweepAndPrune::AllocateProxy()
+{
+	if (m_freeList == b2_nullNode)
+	{
+		b2Assert(m_proxyCount == m_proxyCapacity);
+
+		// The free list is empty. Rebuild bigger arrays.
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity = oldCapacity == 0 ? 16 : 2 * oldCapacity;
+
+		b2SweepProxy* oldProxies = m_proxies;
+		m_proxies = (b2SweepProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SweepProxy));
+		if (oldProxies != nullptr)
+		{
+			memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2SweepProxy));
+			b2Free(oldProxies);
+		}
+
+		b2SweepEntry* oldEntries = m_entries;
+		m_entries = (b2SweepEntry*)b2Alloc(m_proxyCapacity * sizeof(b2SweepEntry));
+		if (oldEntries != nullptr)
+		{
+			memcpy(m_entries, oldEntries, m_proxyCount * sizeof(b2SweepEntry));
+			b2Free(oldEntries);
+		}
+
+		b2Free(m_active);
+		m_active = (int32*)b2Alloc(m_proxyCapacity * sizeof(int32));
+
+		// Build a linked list for the free list.
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].allocated = false;
+		}
+		m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+		m_proxies[m_proxyCapacity - 1].allocated = false;
+		m_freeList = oldCapacity;
+	}
+
+	// Peel a proxy off the free list.
+	int32 proxyId = m_freeList;
+	m_freeList = m_proxies[proxyId].next;
+	m_proxies[proxyId].userData = nullptr;
+	m_proxies[proxyId].sortIndex = b2_nullNode;
+	m_proxies[proxyId].allocated = true;
+	m_proxies[proxyId].moved = false;
+	return proxyId;
+}
+
+// Return a proxy to the pool.
+void b2SweepAndPrune::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].next = m_freeList;
+	m_proxies[proxyId].allocated = false;
+	m_freeList = proxyId;
+}
+
+int32 b2SweepAndPrune::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId = AllocateProxy();
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2AABB fatAABB;
+	fatAABB.lowerBound = aabb.lowerBound - r;
+	fatAABB.upperBound = aabb.upperBound + r;
+
+	// Open a slot in the sorted array. This is an append if proxies
+	// are created from left to right.
+	int32 index = LowerBound(fatAABB.lowerBound.x);
+	memmove(m_entries + index + 1, m_entries + index, (m_proxyCount - index) * sizeof(b2SweepEntry));
+	for (int32 i = index + 1; i <= m_proxyCount; ++i)
+	{
+		m_proxies[m_entries[i].proxyId].sortIndex = i;
+	}
+
+	m_entries[index].aabb = fatAABB;
+	m_entries[index].proxyId = proxyId;
+	++m_proxyCount;
+
+	m_proxies[proxyId].userData = userData;
+	m_proxies[proxyId].sortIndex = index;
+	m_proxies[proxyId].moved = true;
+
+	m_maxExtent = b2Max(m_maxExtent, fatAABB.upperBound.x - fatAABB.lowerBound.x);
+
+	return proxyId;
+}
+
+void b2SweepAndPrune::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	// Close the slot in the sorted array.
+	int32 index = m_proxies[proxyId].sortIndex;
+	memmove(m_entries + index, m_entries + index + 1, (m_proxyCount - index - 1) * sizeof(b2SweepEntry));
+	--m_proxyCount;
+	for (int32 i = index; i < m_proxyCount; ++i)
+	{
+		m_proxies[m_entries[i].proxyId].sortIndex = i;
+	}
+
+	FreeProxy(proxyId);
+}
+
+bool b2SweepAndPrune::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	b2AABB fatAABB = b2ComputeFatAABB(aabb, displacement);
+
+	int32 index = m_proxies[proxyId].sortIndex;
+	if (b2NeedsFatAABBUpdate(m_entries[index].aabb, aabb, fatAABB) == false)
+	{
+		return false;
+	}
+
+	m_entries[index].aabb = fatAABB;
+	SortEntry(index);
+
+	m_proxies[proxyId].moved = true;
+
+	m_maxExtent = b2Max(m_maxExtent, fatAABB.upperBound.x - fatAABB.lowerBound.x);
+
+	return true;
+}
+
+void b2SweepAndPrune::SortEntry(int32 index)
+{
+	b2SweepEntry entry = m_entries[index];
+	float x = entry.aabb.lowerBound.x;
+
+	// Shift left neighbors right, or right neighbors left. Temporal
+	// coherence keeps the number of shifts small.
+	while (index > 0 && m_entries[index - 1].aabb.lowerBound.x > x)
+	{
+		m_entries[index] = m_entries[index - 1];
+		m_proxies[m_entries[index].proxyId].sortIndex = index;
+		--index;
+	}
+
+	while (index < m_proxyCount - 1 && m_entries[index + 1].aabb.lowerBound.x < x)
+	{
+		m_entries[index] = m_entries[index + 1];
+		m_proxies[m_entries[index].proxyId].sortIndex = index;
+		++index;
+	}
+
+	m_entries[index] = entry;
+	m_proxies[entry.proxyId].sortIndex = index;
+}
+
+void b2SweepAndPrune::Validate() const
+{
+#if defined(b2DEBUG)
+	int32 allocatedCount = 0;
+	for (int32 i = 0; i < m_proxyCapacity; ++i)
+	{
+		if (m_proxies[i].allocated)
+		{
+			++allocatedCount;
+		}
+	}
+	b2Assert(allocatedCount == m_proxyCount);
+
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+		b2Assert(m_proxies[entry->proxyId].allocated);
+		b2Assert(m_proxies[entry->proxyId].sortIndex == i);
+		b2Assert(entry->aabb.upperBound.x - entry->aabb.lowerBound.x <= m_maxExtent);
+
+		if (i > 0)
+		{
+			b2Assert(m_entries[i - 1].aabb.lowerBound.x <= entry->aabb.lowerBound.x);
+		}
+	}
+#endif
+}
+
+void b2SweepAndPrune::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// Shifting preserves the sort order.
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		m_entries[i].aabb.lowerBound -= newOrigin;
+		m_entries[i].aabb.upperBound -= newOrigin;
+	}
+}
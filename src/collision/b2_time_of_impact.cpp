@@ -33,6 +33,10 @@ B2_API float b2_toiTime, b2_toiMaxTime;
 B2_API int32 b2_toiCalls, b2_toiIters, b2_toiMaxIters;
 B2_API int32 b2_toiRootIters, b2_toiMaxRootIters;
 
+// GJK statistics for the distance calls made here. b2Distance does not update
+// these so that distance and overlap tests may run on several threads.
+B2_API int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
+
 //
 struct b2SeparationFunction
 {
@@ -309,6 +313,10 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 		b2DistanceOutput distanceOutput;
 		b2Distance(&distanceOutput, &cache, &distanceInput);
 
+		++b2_gjkCalls;
+		b2_gjkIters += distanceOutput.iterations;
+		b2_gjkMaxIters = b2Max(b2_gjkMaxIters, distanceOutput.iterations);
+
 		// If the shapes are overlapped, we give up on continuous collision.
 		if (distanceOutput.distance <= 0.0f)
 		{
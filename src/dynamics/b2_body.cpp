@@ -468,6 +468,21 @@ void b2Body::SynchronizeFixtures()
 	}
 }
 
+// Covers the motion predicted by the current velocity over the next time step.
+void b2Body::SynchronizeSpeculativeFixtures(float dt)
+{
+	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+
+	b2Transform xf2;
+	xf2.q.Set(m_sweep.a + dt * m_angularVelocity);
+	xf2.p = m_sweep.c + dt * m_linearVelocity - b2Mul(xf2.q, m_sweep.localCenter);
+
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->Synchronize(broadPhase, m_xf, xf2);
+	}
+}
+
 void b2Body::SetEnabled(bool flag)
 {
 	b2Assert(m_world->IsLocked() == false);
@@ -20,12 +20,17 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "b2_capsule_circle_contact.h"
+#include "b2_capsule_contact.h"
+#include "b2_chain_capsule_contact.h"
 #include "b2_chain_circle_contact.h"
 #include "b2_chain_polygon_contact.h"
 #include "b2_circle_contact.h"
 #include "b2_contact_solver.h"
+#include "b2_edge_capsule_contact.h"
 #include "b2_edge_circle_contact.h"
 #include "b2_edge_polygon_contact.h"
+#include "b2_polygon_capsule_contact.h"
 #include "b2_polygon_circle_contact.h"
 #include "b2_polygon_contact.h"
 
@@ -41,31 +46,73 @@
 b2ContactRegister b2Contact::s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 bool b2Contact::s_initialized = false;
 
+// The qualified call avoids the virtual dispatch, so the loop stays on one collider.
+template <typename T>
+void b2Contact::UpdateBatch(b2Contact** contacts, const b2Transform* xfAs, const b2Transform* xfBs,
+							const int32* indices, int32 count, b2ContactListener* listener,
+							float speculativeTime)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 index = indices[i];
+		T* contact = static_cast<T*>(contacts[index]);
+
+		b2Manifold manifold;
+		contact->T::Evaluate(&manifold, xfAs[index], xfBs[index]);
+
+		if (manifold.pointCount == 0 && speculativeTime > 0.0f)
+		{
+			contact->EvaluateSpeculative(&manifold, xfAs[index], xfBs[index], speculativeTime);
+		}
+
+		contact->Finish(listener, &manifold);
+	}
+}
+
 void b2Contact::InitializeRegisters()
 {
-	AddType(b2CircleContact::Create, b2CircleContact::Destroy, b2Shape::e_circle, b2Shape::e_circle);
-	AddType(b2PolygonAndCircleContact::Create, b2PolygonAndCircleContact::Destroy, b2Shape::e_polygon, b2Shape::e_circle);
-	AddType(b2PolygonContact::Create, b2PolygonContact::Destroy, b2Shape::e_polygon, b2Shape::e_polygon);
-	AddType(b2EdgeAndCircleContact::Create, b2EdgeAndCircleContact::Destroy, b2Shape::e_edge, b2Shape::e_circle);
-	AddType(b2EdgeAndPolygonContact::Create, b2EdgeAndPolygonContact::Destroy, b2Shape::e_edge, b2Shape::e_polygon);
-	AddType(b2ChainAndCircleContact::Create, b2ChainAndCircleContact::Destroy, b2Shape::e_chain, b2Shape::e_circle);
-	AddType(b2ChainAndPolygonContact::Create, b2ChainAndPolygonContact::Destroy, b2Shape::e_chain, b2Shape::e_polygon);
+	AddType(b2CircleContact::Create, b2CircleContact::Destroy, UpdateBatch<b2CircleContact>,
+			b2Shape::e_circle, b2Shape::e_circle);
+	AddType(b2PolygonAndCircleContact::Create, b2PolygonAndCircleContact::Destroy, UpdateBatch<b2PolygonAndCircleContact>,
+			b2Shape::e_polygon, b2Shape::e_circle);
+	AddType(b2PolygonContact::Create, b2PolygonContact::Destroy, UpdateBatch<b2PolygonContact>,
+			b2Shape::e_polygon, b2Shape::e_polygon);
+	AddType(b2EdgeAndCircleContact::Create, b2EdgeAndCircleContact::Destroy, UpdateBatch<b2EdgeAndCircleContact>,
+			b2Shape::e_edge, b2Shape::e_circle);
+	AddType(b2EdgeAndPolygonContact::Create, b2EdgeAndPolygonContact::Destroy, UpdateBatch<b2EdgeAndPolygonContact>,
+			b2Shape::e_edge, b2Shape::e_polygon);
+	AddType(b2ChainAndCircleContact::Create, b2ChainAndCircleContact::Destroy, UpdateBatch<b2ChainAndCircleContact>,
+			b2Shape::e_chain, b2Shape::e_circle);
+	AddType(b2ChainAndPolygonContact::Create, b2ChainAndPolygonContact::Destroy, UpdateBatch<b2ChainAndPolygonContact>,
+			b2Shape::e_chain, b2Shape::e_polygon);
+	AddType(b2CapsuleContact::Create, b2CapsuleContact::Destroy, UpdateBatch<b2CapsuleContact>,
+			b2Shape::e_capsule, b2Shape::e_capsule);
+	AddType(b2CapsuleAndCircleContact::Create, b2CapsuleAndCircleContact::Destroy, UpdateBatch<b2CapsuleAndCircleContact>,
+			b2Shape::e_capsule, b2Shape::e_circle);
+	AddType(b2PolygonAndCapsuleContact::Create, b2PolygonAndCapsuleContact::Destroy, UpdateBatch<b2PolygonAndCapsuleContact>,
+			b2Shape::e_polygon, b2Shape::e_capsule);
+	AddType(b2EdgeAndCapsuleContact::Create, b2EdgeAndCapsuleContact::Destroy, UpdateBatch<b2EdgeAndCapsuleContact>,
+			b2Shape::e_edge, b2Shape::e_capsule);
+	AddType(b2ChainAndCapsuleContact::Create, b2ChainAndCapsuleContact::Destroy, UpdateBatch<b2ChainAndCapsuleContact>,
+			b2Shape::e_chain, b2Shape::e_capsule);
 }
 
 void b2Contact::AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* destoryFcn,
-						b2Shape::Type type1, b2Shape::Type type2)
+						b2ContactUpdateFcn* updateFcn, b2Shape::Type type1, b2Shape::Type type2)
 {
 	b2Assert(0 <= type1 && type1 < b2Shape::e_typeCount);
 	b2Assert(0 <= type2 && type2 < b2Shape::e_typeCount);
 	
 	s_registers[type1][type2].createFcn = createFcn;
 	s_registers[type1][type2].destroyFcn = destoryFcn;
+	s_registers[type1][type2].updateFcn = updateFcn;
 	s_registers[type1][type2].primary = true;
 
 	if (type1 != type2)
 	{
 		s_registers[type2][type1].createFcn = createFcn;
 		s_registers[type2][type1].destroyFcn = destoryFcn;
+		s_registers[type2][type1].updateFcn = updateFcn;
 		s_registers[type2][type1].primary = false;
 	}
 }
@@ -138,6 +185,7 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 	m_indexB = indexB;
 
 	m_manifold.pointCount = 0;
+	m_simplexCache.count = 0;
 
 	m_prev = nullptr;
 	m_next = nullptr;
@@ -163,7 +211,99 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 
 // Update the contact manifold and touching status.
 // Note: do not assume the fixture AABBs are overlapping or are valid.
-void b2Contact::Update(b2ContactListener* listener)
+bool b2Contact::Update(b2ContactListener* listener, bool allowReuse)
+{
+	if (NeedsEvaluate(allowReuse, false))
+	{
+		b2Manifold manifold;
+		Evaluate(&manifold, m_fixtureA->GetBody()->GetTransform(), m_fixtureB->GetBody()->GetTransform());
+		Finish(listener, &manifold);
+		return false;
+	}
+
+	Finish(listener, nullptr);
+	return m_fixtureA->IsSensor() == false && m_fixtureB->IsSensor() == false;
+}
+
+// The manifold is evaluated with body B moved along the closest point normal until the
+// shapes just touch. Manifolds are local to the bodies, so the solver still sees the real
+// positive separations.
+void b2Contact::EvaluateSpeculative(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB,
+									float timeStep)
+{
+	b2Assert(manifold->pointCount == 0);
+
+	b2DistanceInput input;
+	input.proxyA.Set(m_fixtureA->GetShape(), m_indexA);
+	input.proxyB.Set(m_fixtureB->GetShape(), m_indexB);
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = false;
+
+	b2DistanceOutput output;
+	b2Distance(&output, &m_simplexCache, &input);
+
+	// Overlapping cores have no closest points.
+	if (output.distance < 10.0f * b2_epsilon)
+	{
+		return;
+	}
+
+	// Shapes that just touch can still be missed by the collider, so they are handled here too.
+	float separation = b2Max(output.distance - input.proxyA.m_radius - input.proxyB.m_radius, 0.0f);
+
+	b2Vec2 normal = (1.0f / output.distance) * (output.pointB - output.pointA);
+
+	// Closing speed at the closest points.
+	const b2Body* bodyA = m_fixtureA->GetBody();
+	const b2Body* bodyB = m_fixtureB->GetBody();
+	b2Vec2 vA = bodyA->GetLinearVelocityFromWorldPoint(output.pointA);
+	b2Vec2 vB = bodyB->GetLinearVelocityFromWorldPoint(output.pointB);
+	float closing = -timeStep * b2Dot(vB - vA, normal);
+
+	if (closing <= 0.0f || separation > closing + b2_speculativeDistance)
+	{
+		return;
+	}
+
+	b2Transform touchingB = xfB;
+	touchingB.p -= (separation + 0.5f * b2_linearSlop) * normal;
+	Evaluate(manifold, xfA, touchingB);
+}
+
+bool b2Contact::NeedsEvaluate(bool allowReuse, bool speculative) const
+{
+	// Sensors don't generate manifolds.
+	if (m_fixtureA->IsSensor() || m_fixtureB->IsSensor())
+	{
+		return false;
+	}
+
+	if (allowReuse == false || (m_flags & e_manifoldPoseFlag) == 0)
+	{
+		return true;
+	}
+
+	// The pose test ignores velocity, so a pair that is apart could start closing fast
+	// without moving. Only evaluation can add the speculative points that stop it.
+	if (speculative && m_manifold.pointCount == 0)
+	{
+		return true;
+	}
+
+	// Keep the manifold if the bodies barely moved relative to each other since it was
+	// evaluated. The manifold points are local to the bodies, so the solver still
+	// projects them with the current transforms.
+	const b2Transform& xfA = m_fixtureA->GetBody()->GetTransform();
+	const b2Transform& xfB = m_fixtureB->GetBody()->GetTransform();
+	b2Transform xf = b2MulT(xfA, xfB);
+	b2Rot dq = b2MulT(m_manifoldXf.q, xf.q);
+	bool reuse = b2DistanceSquared(xf.p, m_manifoldXf.p) < b2_manifoldLinearTolerance * b2_manifoldLinearTolerance &&
+				 dq.c > 0.0f && b2Abs(dq.s) < b2_manifoldAngularTolerance;
+	return reuse == false;
+}
+
+void b2Contact::Finish(b2ContactListener* listener, const b2Manifold* manifold)
 {
 	b2Manifold oldManifold = m_manifold;
 
@@ -185,40 +325,50 @@ void b2Contact::Update(b2ContactListener* listener)
 	// Is this contact a sensor?
 	if (sensor)
 	{
+		b2Assert(manifold == nullptr);
+
 		const b2Shape* shapeA = m_fixtureA->GetShape();
 		const b2Shape* shapeB = m_fixtureB->GetShape();
-		touching = b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB);
+		touching = b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB, &m_simplexCache);
 
 		// Sensors don't generate manifolds.
 		m_manifold.pointCount = 0;
+		m_flags &= ~e_manifoldPoseFlag;
 	}
 	else
 	{
-		Evaluate(&m_manifold, xfA, xfB);
-		touching = m_manifold.pointCount > 0;
-
-		// Match old contact ids to new contact ids and copy the
-		// stored impulses to warm start the solver.
-		for (int32 i = 0; i < m_manifold.pointCount; ++i)
+		// A null manifold means the current one is reused.
+		if (manifold != nullptr)
 		{
-			b2ManifoldPoint* mp2 = m_manifold.points + i;
-			mp2->normalImpulse = 0.0f;
-			mp2->tangentImpulse = 0.0f;
-			b2ContactID id2 = mp2->id;
+			m_manifold = *manifold;
+			m_manifoldXf = b2MulT(xfA, xfB);
+			m_flags |= e_manifoldPoseFlag;
 
-			for (int32 j = 0; j < oldManifold.pointCount; ++j)
+			// Match old contact ids to new contact ids and copy the
+			// stored impulses to warm start the solver.
+			for (int32 i = 0; i < m_manifold.pointCount; ++i)
 			{
-				b2ManifoldPoint* mp1 = oldManifold.points + j;
+				b2ManifoldPoint* mp2 = m_manifold.points + i;
+				mp2->normalImpulse = 0.0f;
+				mp2->tangentImpulse = 0.0f;
+				b2ContactID id2 = mp2->id;
 
-				if (mp1->id.key == id2.key)
+				for (int32 j = 0; j < oldManifold.pointCount; ++j)
 				{
-					mp2->normalImpulse = mp1->normalImpulse;
-					mp2->tangentImpulse = mp1->tangentImpulse;
-					break;
+					b2ManifoldPoint* mp1 = oldManifold.points + j;
+
+					if (mp1->id.key == id2.key)
+					{
+						mp2->normalImpulse = mp1->normalImpulse;
+						mp2->tangentImpulse = mp1->tangentImpulse;
+						break;
+					}
 				}
 			}
 		}
 
+		touching = m_manifold.pointCount > 0;
+
 		if (touching != wasTouching)
 		{
 			bodyA->SetAwake(true);
@@ -36,6 +36,10 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = nullptr;
+	m_manifoldReuse = false;
+	m_reusedManifoldCount = 0;
+	m_speculativeTime = 0.0f;
+	m_batchCount = 0;
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -105,9 +109,15 @@ void b2ContactManager::Destroy(b2Contact* c)
 
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
-// contact list.
+// contact list. Contacts that need a new manifold are gathered into a small
+// batch along with their transforms. Each full batch is updated in one tight loop per
+// shape pair type instead of through the virtual Evaluate in list order. The batch is
+// small so the contacts are still in cache when they are evaluated.
 void b2ContactManager::Collide()
 {
+	m_reusedManifoldCount = 0;
+	m_batchCount = 0;
+
 	// Update awake contacts.
 	b2Contact* c = m_contactList;
 	while (c)
@@ -122,6 +132,15 @@ void b2ContactManager::Collide()
 		// Is this contact flagged for filtering?
 		if (c->m_flags & b2Contact::e_filterFlag)
 		{
+			// Do these layers collide?
+			if (m_broadPhase.GetLayerCollision(fixtureA->m_filter.layer, fixtureB->m_filter.layer) == false)
+			{
+				b2Contact* cNuke = c;
+				c = cNuke->GetNext();
+				Destroy(cNuke);
+				continue;
+			}
+
 			// Should these bodies collide?
 			if (bodyB->ShouldCollide(bodyA) == false)
 			{
@@ -140,8 +159,10 @@ void b2ContactManager::Collide()
 				continue;
 			}
 
-			// Clear the filtering flag.
-			c->m_flags &= ~b2Contact::e_filterFlag;
+			// Clear the filtering flag. Refiltering also refreshes the manifold and the
+			// simplex cache in case a shape was edited in place.
+			c->m_flags &= ~(b2Contact::e_filterFlag | b2Contact::e_manifoldPoseFlag);
+			c->m_simplexCache.count = 0;
 		}
 
 		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
@@ -167,10 +188,83 @@ void b2ContactManager::Collide()
 			continue;
 		}
 
-		// The contact persists.
-		c->Update(m_contactListener);
+		// The contact persists. Gather it if it needs a new manifold.
+		if (c->NeedsEvaluate(m_manifoldReuse, m_speculativeTime > 0.0f))
+		{
+			m_batchContacts[m_batchCount] = c;
+			m_batchTypes[m_batchCount] = fixtureA->GetType() * b2Shape::e_typeCount + fixtureB->GetType();
+			m_batchXfAs[m_batchCount] = bodyA->GetTransform();
+			m_batchXfBs[m_batchCount] = bodyB->GetTransform();
+			++m_batchCount;
+
+			if (m_batchCount == b2_contactBatchSize)
+			{
+				UpdateBatch();
+			}
+		}
+		else
+		{
+			if (fixtureA->IsSensor() == false && fixtureB->IsSensor() == false)
+			{
+				++m_reusedManifoldCount;
+			}
+
+			c->Finish(m_contactListener, nullptr);
+		}
+
 		c = c->GetNext();
 	}
+
+	UpdateBatch();
+}
+
+void b2ContactManager::UpdateBatch()
+{
+	// Group the gathered contacts by shape pair type.
+	const int32 typeCount = b2Shape::e_typeCount * b2Shape::e_typeCount;
+	int32 typeStarts[typeCount];
+	int32 typeSizes[typeCount];
+	for (int32 i = 0; i < typeCount; ++i)
+	{
+		typeSizes[i] = 0;
+	}
+
+	for (int32 i = 0; i < m_batchCount; ++i)
+	{
+		++typeSizes[m_batchTypes[i]];
+	}
+
+	int32 start = 0;
+	for (int32 i = 0; i < typeCount; ++i)
+	{
+		typeStarts[i] = start;
+		start += typeSizes[i];
+		typeSizes[i] = 0;
+	}
+
+	for (int32 i = 0; i < m_batchCount; ++i)
+	{
+		int32 type = m_batchTypes[i];
+		m_batchOrder[typeStarts[type] + typeSizes[type]] = i;
+		++typeSizes[type];
+	}
+
+	// Update each type with its own collider.
+	for (int32 i = 0; i < typeCount; ++i)
+	{
+		if (typeSizes[i] == 0)
+		{
+			continue;
+		}
+
+		int32 typeA = i / b2Shape::e_typeCount;
+		int32 typeB = i % b2Shape::e_typeCount;
+		b2ContactUpdateFcn* updateFcn = b2Contact::s_registers[typeA][typeB].updateFcn;
+		updateFcn(m_batchContacts, m_batchXfAs, m_batchXfBs, m_batchOrder + typeStarts[i], typeSizes[i],
+				  m_contactListener, m_speculativeTime);
+	}
+
+	m_batchCount = 0;
 }
 
 void b2ContactManager::FindNewContacts()
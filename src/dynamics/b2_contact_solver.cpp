@@ -214,7 +214,17 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			// Setup a velocity bias for restitution.
 			vcp->velocityBias = 0.0f;
 			float vRel = b2Dot(vc->normal, vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA));
-			if (vRel < -vc->threshold)
+			vcp->relativeVelocity = vRel;
+			if (m_step.speculative)
+			{
+				// Speculative point: allow the shapes to close the gap but no further.
+				// Restitution is applied after the velocity iterations instead.
+				if (worldManifold.separations[j] > 0.0f)
+				{
+					vcp->velocityBias = -m_step.inv_dt * worldManifold.separations[j];
+				}
+			}
+			else if (vRel < -vc->threshold)
 			{
 				vcp->velocityBias = -vc->restitution * vRel;
 			}
@@ -606,6 +616,78 @@ void b2ContactSolver::SolveVelocityConstraints()
 	}
 }
 
+// With speculative contacts the restitution is not part of the velocity bias, since a
+// speculative point only closes the gap. Once the velocity iterations have stopped the
+// shapes, push the points that were approaching fast enough and carry an impulse to the
+// bounce velocity.
+void b2ContactSolver::ApplyRestitution()
+{
+	if (m_step.speculative == false)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		if (vc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+		int32 pointCount = vc->pointCount;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		b2Vec2 normal = vc->normal;
+
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2VelocityConstraintPoint* vcp = vc->points + j;
+
+			if (vcp->relativeVelocity > -vc->threshold || vcp->normalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			// Relative velocity at contact
+			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			float vn = b2Dot(dv, normal);
+
+			// Compute normal impulse to reach the bounce velocity
+			float lambda = -vcp->normalMass * (vn + vc->restitution * vcp->relativeVelocity);
+
+			// b2Clamp the accumulated impulse
+			float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+
+			// Apply contact impulse
+			b2Vec2 P = lambda * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(vcp->rA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(vcp->rB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
 void b2ContactSolver::StoreImpulses()
 {
 	for (int32 i = 0; i < m_count; ++i)
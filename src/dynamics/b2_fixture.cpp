@@ -23,6 +23,7 @@
 #include "box2d/b2_fixture.h"
 #include "box2d/b2_block_allocator.h"
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_chain_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
@@ -115,6 +116,14 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* s = (b2CapsuleShape*)m_shape;
+			s->~b2CapsuleShape();
+			allocator->Free(s, sizeof(b2CapsuleShape));
+		}
+		break;
+
 	default:
 		b2Assert(false);
 		break;
@@ -135,6 +144,8 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 		b2FixtureProxy* proxy = m_proxies + i;
 		m_shape->ComputeAABB(&proxy->aabb, xf, i);
 		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
+		broadPhase->SetCategoryBits(proxy->proxyId, m_filter.categoryBits);
+		broadPhase->SetLayer(proxy->proxyId, m_filter.layer);
 		proxy->fixture = this;
 		proxy->childIndex = i;
 	}
@@ -146,6 +157,7 @@ void b2Fixture::DestroyProxies(b2BroadPhase* broadPhase)
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
 		b2FixtureProxy* proxy = m_proxies + i;
+		m_body->GetWorld()->InvalidateQueries(proxy->proxyId);
 		broadPhase->DestroyProxy(proxy->proxyId);
 		proxy->proxyId = b2BroadPhase::e_nullProxy;
 	}
@@ -217,6 +229,8 @@ void b2Fixture::Refilter()
 	b2BroadPhase* broadPhase = &world->m_contactManager.m_broadPhase;
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
+		broadPhase->SetCategoryBits(m_proxies[i].proxyId, m_filter.categoryBits);
+		broadPhase->SetLayer(m_proxies[i].proxyId, m_filter.layer);
 		broadPhase->TouchProxy(m_proxies[i].proxyId);
 	}
 }
@@ -240,6 +254,7 @@ void b2Fixture::Dump(int32 bodyIndex)
 	b2Dump("    fd.isSensor = bool(%d);\n", m_isSensor);
 	b2Dump("    fd.filter.categoryBits = uint16(%d);\n", m_filter.categoryBits);
 	b2Dump("    fd.filter.maskBits = uint16(%d);\n", m_filter.maskBits);
+	b2Dump("    fd.filter.layer = uint8(%d);\n", m_filter.layer);
 	b2Dump("    fd.filter.groupIndex = int16(%d);\n", m_filter.groupIndex);
 
 	switch (m_shape->m_type)
@@ -294,6 +309,16 @@ void b2Fixture::Dump(int32 bodyIndex)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* s = (b2CapsuleShape*)m_shape;
+			b2Dump("    b2CapsuleShape shape;\n");
+			b2Dump("    shape.m_radius = %.9g;\n", s->m_radius);
+			b2Dump("    shape.m_center1.Set(%.9g, %.9g);\n", s->m_center1.x, s->m_center1.y);
+			b2Dump("    shape.m_center2.Set(%.9g, %.9g);\n", s->m_center2.x, s->m_center2.y);
+		}
+		break;
+
 	default:
 		return;
 	}
@@ -272,6 +272,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		contactSolver.SolveVelocityConstraints();
 	}
 
+	contactSolver.ApplyRestitution();
+
 	// Store impulses for warm starting
 	contactSolver.StoreImpulses();
 	profile->solveVelocity = timer.GetMilliseconds();
@@ -0,0 +1,156 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_persistent_query.h"
+#include "box2d/b2_broad_phase.h"
+#include "box2d/b2_fixture.h"
+#include "box2d/b2_world.h"
+
+#include <algorithm>
+#include <string.h>
+
+b2PersistentQuery::b2PersistentQuery(b2World* world, const b2AABB& aabb)
+{
+	m_world = world;
+	m_prev = nullptr;
+	m_next = nullptr;
+	m_aabb = aabb;
+	m_entries = nullptr;
+	m_count = 0;
+	m_capacity = 0;
+	m_moveEpoch = world->m_moveEpoch;
+	m_moveIndex = 0;
+	m_valid = false;
+	m_userData = nullptr;
+}
+
+b2PersistentQuery::~b2PersistentQuery()
+{
+	b2Free(m_entries);
+}
+
+void b2PersistentQuery::SetAABB(const b2AABB& aabb)
+{
+	m_aabb = aabb;
+	m_valid = false;
+}
+
+void b2PersistentQuery::AddEntry(int32 proxyId, b2Fixture* fixture)
+{
+	if (m_count == m_capacity)
+	{
+		Entry* oldEntries = m_entries;
+		m_capacity = b2Max(2 * m_capacity, 16);
+		m_entries = (Entry*)b2Alloc(m_capacity * sizeof(Entry));
+		if (oldEntries != nullptr)
+		{
+			memcpy(m_entries, oldEntries, m_count * sizeof(Entry));
+			b2Free(oldEntries);
+		}
+	}
+
+	m_entries[m_count].proxyId = proxyId;
+	m_entries[m_count].fixture = fixture;
+	++m_count;
+}
+
+void b2PersistentQuery::TouchProxy(int32 proxyId)
+{
+	if (m_valid == false)
+	{
+		return;
+	}
+
+	Entry key;
+	key.proxyId = proxyId;
+	key.fixture = nullptr;
+	if (std::binary_search(m_entries, m_entries + m_count, key))
+	{
+		m_valid = false;
+	}
+}
+
+void b2PersistentQuery::TouchProxy(int32 proxyId, const b2AABB& fatAABB)
+{
+	if (m_valid && b2TestOverlap(fatAABB, m_aabb))
+	{
+		m_valid = false;
+		return;
+	}
+
+	// The proxy may have left the AABB.
+	TouchProxy(proxyId);
+}
+
+struct b2PersistentQueryWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		query->AddEntry(proxyId, proxy->fixture);
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2PersistentQuery* query;
+};
+
+void b2PersistentQuery::TouchMovedProxies()
+{
+	const b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	int32 moveCount = broadPhase->GetMoveCount();
+	int32 index = m_moveEpoch == m_world->m_moveEpoch ? m_moveIndex : 0;
+
+	for (; index < moveCount && m_valid; ++index)
+	{
+		int32 proxyId = broadPhase->GetMoveProxy(index);
+		if (proxyId != b2BroadPhase::e_nullProxy)
+		{
+			TouchProxy(proxyId, broadPhase->GetFatAABB(proxyId));
+		}
+	}
+
+	m_moveEpoch = m_world->m_moveEpoch;
+	m_moveIndex = moveCount;
+}
+
+int32 b2PersistentQuery::Update()
+{
+	// Moves are buffered until the next time step, such as after b2Body::SetTransform.
+	TouchMovedProxies();
+
+	if (m_valid)
+	{
+		return m_count;
+	}
+
+	m_count = 0;
+
+	b2PersistentQueryWrapper wrapper;
+	wrapper.broadPhase = &m_world->m_contactManager.m_broadPhase;
+	wrapper.query = this;
+	wrapper.broadPhase->Query(&wrapper, m_aabb);
+
+	std::sort(m_entries, m_entries + m_count);
+	m_valid = true;
+	return m_count;
+}
@@ -25,6 +25,7 @@
 #include "box2d/b2_block_allocator.h"
 #include "box2d/b2_body.h"
 #include "box2d/b2_fixture.h"
+#include "box2d/b2_polygon_shape.h"
 #include "box2d/b2_time_of_impact.h"
 #include "box2d/b2_world_callbacks.h"
 
@@ -47,11 +48,24 @@ b2PolygonContact::b2PolygonContact(b2Fixture* fixtureA, b2Fixture* fixtureB)
 {
 	b2Assert(m_fixtureA->GetType() == b2Shape::e_polygon);
 	b2Assert(m_fixtureB->GetType() == b2Shape::e_polygon);
+
+	m_countA = ((b2PolygonShape*)m_fixtureA->GetShape())->m_count;
+	m_countB = ((b2PolygonShape*)m_fixtureB->GetShape())->m_count;
+	m_collider = b2GetPolygonCollider(m_countA, m_countB);
 }
 
 void b2PolygonContact::Evaluate(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB)
 {
-	b2CollidePolygons(	manifold,
-						(b2PolygonShape*)m_fixtureA->GetShape(), xfA,
-						(b2PolygonShape*)m_fixtureB->GetShape(), xfB);
+	b2PolygonShape* polygonA = (b2PolygonShape*)m_fixtureA->GetShape();
+	b2PolygonShape* polygonB = (b2PolygonShape*)m_fixtureB->GetShape();
+
+	// The user may have changed a polygon since the contact was created.
+	if (polygonA->m_count != m_countA || polygonB->m_count != m_countB)
+	{
+		m_countA = polygonA->m_count;
+		m_countB = polygonB->m_count;
+		m_collider = b2GetPolygonCollider(m_countA, m_countB);
+	}
+
+	m_collider(manifold, polygonA, xfA, polygonB, xfB);
 }
@@ -23,6 +23,7 @@
 #ifndef B2_POLYGON_CONTACT_H
 #define B2_POLYGON_CONTACT_H
 
+#include "box2d/b2_collision.h"
 #include "box2d/b2_contact.h"
 
 class b2BlockAllocator;
@@ -38,6 +39,11 @@ public:
 	~b2PolygonContact() {}
 
 	void Evaluate(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB) override;
+
+private:
+	// Collider specialized for the vertex counts at creation.
+	b2CollidePolygonsFcn* m_collider;
+	int32 m_countA, m_countB;
 };
 
 #endif
@@ -25,10 +25,12 @@
 
 #include "box2d/b2_body.h"
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_chain_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
 #include "box2d/b2_contact.h"
+#include "box2d/b2_distance.h"
 #include "box2d/b2_draw.h"
 #include "box2d/b2_edge_shape.h"
 #include "box2d/b2_fixture.h"
@@ -38,8 +40,10 @@
 #include "box2d/b2_timer.h"
 #include "box2d/b2_world.h"
 
+#include <algorithm>
 #include <new>
 #include <set>
+#include <string.h>
 
 b2World::b2World(const b2Vec2& gravity)
 {
@@ -48,6 +52,8 @@ b2World::b2World(const b2Vec2& gravity)
 
 	m_bodyList = nullptr;
 	m_jointList = nullptr;
+	m_queryList = nullptr;
+	m_moveEpoch = 0;
 
 	m_bodyCount = 0;
 	m_jointCount = 0;
@@ -55,6 +61,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_speculativeContacts = false;
 
 	m_stepComplete = true;
 
@@ -91,6 +98,15 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	// Persistent queries allocate using b2Alloc.
+	b2PersistentQuery* q = m_queryList;
+	while (q)
+	{
+		b2PersistentQuery* qNext = q->m_next;
+		q->~b2PersistentQuery();
+		q = qNext;
+	}
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -113,6 +129,66 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	m_debugDraw = debugDraw;
 }
 
+b2PersistentQuery* b2World::CreatePersistentQuery(const b2AABB& aabb)
+{
+	void* mem = m_blockAllocator.Allocate(sizeof(b2PersistentQuery));
+	b2PersistentQuery* q = new (mem) b2PersistentQuery(this, aabb);
+
+	// Add to world doubly linked list.
+	q->m_prev = nullptr;
+	q->m_next = m_queryList;
+	if (m_queryList)
+	{
+		m_queryList->m_prev = q;
+	}
+	m_queryList = q;
+
+	return q;
+}
+
+void b2World::DestroyPersistentQuery(b2PersistentQuery* q)
+{
+	b2Assert(q->m_world == this);
+
+	// Remove from world doubly linked list.
+	if (q->m_prev)
+	{
+		q->m_prev->m_next = q->m_next;
+	}
+
+	if (q->m_next)
+	{
+		q->m_next->m_prev = q->m_prev;
+	}
+
+	if (q == m_queryList)
+	{
+		m_queryList = q->m_next;
+	}
+
+	q->~b2PersistentQuery();
+	m_blockAllocator.Free(q, sizeof(b2PersistentQuery));
+}
+
+void b2World::InvalidateQueries()
+{
+	for (b2PersistentQuery* q = m_queryList; q; q = q->m_next)
+	{
+		q->TouchMovedProxies();
+	}
+
+	// The move buffer is about to be cleared.
+	++m_moveEpoch;
+}
+
+void b2World::InvalidateQueries(int32 proxyId)
+{
+	for (b2PersistentQuery* q = m_queryList; q; q = q->m_next)
+	{
+		q->TouchProxy(proxyId);
+	}
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -572,11 +648,20 @@ void b2World::Solve(const b2TimeStep& step)
 				continue;
 			}
 
-			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
+			// Update fixtures (for broad-phase). Speculative contacts need the proxies to
+			// cover the motion of the next step. Bullets still use time of impact.
+			if (m_speculativeContacts && b->IsBullet() == false)
+			{
+				b->SynchronizeSpeculativeFixtures(step.dt);
+			}
+			else
+			{
+				b->SynchronizeFixtures();
+			}
 		}
 
 		// Look for new contacts.
+		InvalidateQueries();
 		m_contactManager.FindNewContacts();
 		m_profile.broadphase = timer.GetMilliseconds();
 	}
@@ -667,6 +752,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					continue;
 				}
 
+				// Speculative contacts handle everything but bullets.
+				if (m_speculativeContacts && bA->IsBullet() == false && bB->IsBullet() == false)
+				{
+					continue;
+				}
+
 				// Compute the TOI for this contact.
 				// Put the sweeps onto the same time interval.
 				float alpha0 = bA->m_sweep.alpha0;
@@ -741,7 +832,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		bB->Advance(minAlpha);
 
 		// The TOI contact likely has some new contact points.
-		minContact->Update(m_contactManager.m_contactListener);
+		minContact->Update(m_contactManager.m_contactListener, false);
 		minContact->m_flags &= ~b2Contact::e_toiFlag;
 		++minContact->m_toiCount;
 
@@ -821,7 +912,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					}
 
 					// Update the contact points
-					contact->Update(m_contactManager.m_contactListener);
+					contact->Update(m_contactManager.m_contactListener, false);
 
 					// Was the contact disabled by the user?
 					if (contact->IsEnabled() == false)
@@ -869,6 +960,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.speculative = false;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -882,7 +974,14 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				continue;
 			}
 
-			body->SynchronizeFixtures();
+			if (m_speculativeContacts && body->IsBullet() == false)
+			{
+				body->SynchronizeSpeculativeFixtures(step.dt);
+			}
+			else
+			{
+				body->SynchronizeFixtures();
+			}
 
 			// Invalidate all contact TOIs on this displaced body.
 			for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
@@ -893,6 +992,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
 		// Also, some contacts can be destroyed.
+		InvalidateQueries();
 		m_contactManager.FindNewContacts();
 
 		if (m_subStepping)
@@ -907,9 +1007,12 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 {
 	b2Timer stepTimer;
 
+	m_contactManager.m_broadPhase.ResetRejectedPairCount();
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_newContacts)
 	{
+		InvalidateQueries();
 		m_contactManager.FindNewContacts();
 		m_newContacts = false;
 	}
@@ -934,10 +1037,12 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.speculative = m_speculativeContacts;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
 		b2Timer timer;
+		m_contactManager.m_speculativeTime = m_speculativeContacts ? dt : 0.0f;
 		m_contactManager.Collide();
 		m_profile.collide = timer.GetMilliseconds();
 	}
@@ -982,16 +1087,33 @@ void b2World::ClearForces()
 	}
 }
 
+// A fixture passes a query filter if it would collide with a fixture that has the filter.
+static bool b2TestFilter(const b2Filter& fixtureFilter, const b2Filter& filter)
+{
+	if (fixtureFilter.groupIndex == filter.groupIndex && filter.groupIndex != 0)
+	{
+		return filter.groupIndex > 0;
+	}
+
+	return (fixtureFilter.categoryBits & filter.maskBits) != 0 && (fixtureFilter.maskBits & filter.categoryBits) != 0;
+}
+
 struct b2WorldQueryWrapper
 {
 	bool QueryCallback(int32 proxyId)
 	{
 		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (filter != nullptr && b2TestFilter(proxy->fixture->GetFilterData(), *filter) == false)
+		{
+			return true;
+		}
+
 		return callback->ReportFixture(proxy->fixture);
 	}
 
 	const b2BroadPhase* broadPhase;
 	b2QueryCallback* callback;
+	const b2Filter* filter;
 };
 
 void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const
@@ -999,9 +1121,125 @@ void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const
 	b2WorldQueryWrapper wrapper;
 	wrapper.broadPhase = &m_contactManager.m_broadPhase;
 	wrapper.callback = callback;
+	wrapper.filter = nullptr;
 	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
 }
 
+void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, const b2Filter& filter) const
+{
+	b2WorldQueryWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.callback = callback;
+	wrapper.filter = &filter;
+
+	if (filter.groupIndex > 0)
+	{
+		// Fixtures in the same group pass regardless of category, so nothing can be pruned.
+		m_contactManager.m_broadPhase.Query(&wrapper, aabb);
+	}
+	else
+	{
+		m_contactManager.m_broadPhase.Query(&wrapper, aabb, filter.maskBits);
+	}
+}
+
+struct b2WorldBatchQueryWrapper
+{
+	void QueryCallback(int32 sortedIndex, int32 proxyId)
+	{
+		if (hitCount < capacity)
+		{
+			b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+			hits[hitCount].queryIndex = order[sortedIndex].index;
+			hits[hitCount].fixture = proxy->fixture;
+		}
+
+		++hitCount;
+	}
+
+	struct Key
+	{
+		bool operator<(const Key& other) const
+		{
+			return code < other.code;
+		}
+
+		uint32 code;
+		int32 index;
+	};
+
+	const b2BroadPhase* broadPhase;
+	const Key* order;
+	b2QueryHit* hits;
+	int32 capacity;
+	int32 hitCount;
+};
+
+// Spread the lower 16 bits so there is a zero bit between each one.
+static uint32 b2SpreadBits(uint32 x)
+{
+	x &= 0x0000FFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+int32 b2World::QueryAABBBatch(const b2AABB* aabbs, int32 count, b2QueryHit* hits, int32 capacity) const
+{
+	if (count <= 0)
+	{
+		return 0;
+	}
+
+	typedef b2WorldBatchQueryWrapper::Key Key;
+
+	// Sort the queries along a Morton curve so that packets of queries are compact.
+	// This uses the heap so that several threads can query at once.
+	Key* order = (Key*)b2Alloc(count * sizeof(Key));
+	b2AABB* sortedAABBs = (b2AABB*)b2Alloc(count * sizeof(b2AABB));
+
+	b2AABB bounds = aabbs[0];
+	for (int32 i = 1; i < count; ++i)
+	{
+		bounds.Combine(aabbs[i]);
+	}
+
+	b2Vec2 extents = bounds.upperBound - bounds.lowerBound;
+	float scaleX = extents.x > 0.0f ? 65535.0f / extents.x : 0.0f;
+	float scaleY = extents.y > 0.0f ? 65535.0f / extents.y : 0.0f;
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Vec2 c = aabbs[i].GetCenter() - bounds.lowerBound;
+		uint32 x = uint32(scaleX * c.x);
+		uint32 y = uint32(scaleY * c.y);
+		order[i].code = b2SpreadBits(x) | (b2SpreadBits(y) << 1);
+		order[i].index = i;
+	}
+
+	std::sort(order, order + count);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		sortedAABBs[i] = aabbs[order[i].index];
+	}
+
+	b2WorldBatchQueryWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.order = order;
+	wrapper.hits = hits;
+	wrapper.capacity = capacity;
+	wrapper.hitCount = 0;
+	m_contactManager.m_broadPhase.QueryBatch(&wrapper, sortedAABBs, count);
+
+	b2Free(sortedAABBs);
+	b2Free(order);
+
+	return wrapper.hitCount;
+}
+
 struct b2WorldRayCastWrapper
 {
 	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
@@ -1009,6 +1247,11 @@ struct b2WorldRayCastWrapper
 		void* userData = broadPhase->GetUserData(proxyId);
 		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
 		b2Fixture* fixture = proxy->fixture;
+		if (filter != nullptr && b2TestFilter(fixture->GetFilterData(), *filter) == false)
+		{
+			return input.maxFraction;
+		}
+
 		int32 index = proxy->childIndex;
 		b2RayCastOutput output;
 		bool hit = fixture->RayCast(&output, input, index);
@@ -1025,6 +1268,7 @@ struct b2WorldRayCastWrapper
 
 	const b2BroadPhase* broadPhase;
 	b2RayCastCallback* callback;
+	const b2Filter* filter;
 };
 
 void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const
@@ -1032,11 +1276,600 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	b2WorldRayCastWrapper wrapper;
 	wrapper.broadPhase = &m_contactManager.m_broadPhase;
 	wrapper.callback = callback;
+	wrapper.filter = nullptr;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+}
+
+void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2, const b2Filter& filter) const
+{
+	b2WorldRayCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.callback = callback;
+	wrapper.filter = &filter;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+
+	if (filter.groupIndex > 0)
+	{
+		m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+	}
+	else
+	{
+		m_contactManager.m_broadPhase.RayCast(&wrapper, input, filter.maskBits);
+	}
+}
+
+// Records the hit and clips the ray so that only closer fixtures are visited.
+struct b2WorldRayCastClosestWrapper
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, proxy->childIndex);
+
+		if (hit)
+		{
+			float fraction = output.fraction;
+			result.fixture = fixture;
+			result.point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			result.normal = output.normal;
+			result.fraction = fraction;
+			return terminate ? 0.0f : fraction;
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2RayCastHit result;
+	bool terminate;
+};
+
+bool b2World::RayCastClosest(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hit) const
+{
+	b2WorldRayCastClosestWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.result.fixture = nullptr;
+	wrapper.terminate = false;
 	b2RayCastInput input;
 	input.maxFraction = 1.0f;
 	input.p1 = point1;
 	input.p2 = point2;
 	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+
+	if (wrapper.result.fixture == nullptr)
+	{
+		return false;
+	}
+
+	*hit = wrapper.result;
+	return true;
+}
+
+bool b2World::RayCastAny(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hit) const
+{
+	b2WorldRayCastClosestWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.result.fixture = nullptr;
+	wrapper.terminate = true;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+
+	if (wrapper.result.fixture == nullptr)
+	{
+		return false;
+	}
+
+	if (hit != nullptr)
+	{
+		*hit = wrapper.result;
+	}
+
+	return true;
+}
+
+struct b2WorldRayCastBatchWrapper
+{
+	float RayCastCallback(int32 rayIndex, const b2RayCastInput& input, int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, proxy->childIndex);
+
+		if (hit)
+		{
+			// Clip the ray so that only closer hits are reported.
+			float fraction = output.fraction;
+			b2RayCastHit* result = hits + rayIndex;
+			result->fixture = fixture;
+			result->point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			result->normal = output.normal;
+			result->fraction = fraction;
+			return fraction;
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2RayCastHit* hits;
+};
+
+void b2World::RayCastBatch(const b2RayCastInput* inputs, b2RayCastHit* hits, int32 count) const
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		hits[i].fixture = nullptr;
+		hits[i].point = inputs[i].p1;
+		hits[i].normal.SetZero();
+		hits[i].fraction = inputs[i].maxFraction;
+	}
+
+	b2WorldRayCastBatchWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.hits = hits;
+	m_contactManager.m_broadPhase.RayCastPacket(&wrapper, inputs, count);
+}
+
+struct b2WorldShapeCastWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+
+		// Reject fixtures beyond the current best hit.
+		b2AABB sweptAABB;
+		sweptAABB.lowerBound = aabb.lowerBound + b2Min(b2Vec2_zero, fraction * translation);
+		sweptAABB.upperBound = aabb.upperBound + b2Max(b2Vec2_zero, fraction * translation);
+		if (b2TestOverlap(sweptAABB, proxy->aabb) == false)
+		{
+			return true;
+		}
+
+		b2Fixture* fixture = proxy->fixture;
+
+		// Sweep only up to the current best hit so that b2ShapeCast can exit early.
+		b2ShapeCastInput input;
+		input.proxyA.Set(fixture->GetShape(), proxy->childIndex);
+		input.proxyB = *shapeProxy;
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB = transform;
+		input.translationB = fraction * translation;
+
+		b2ShapeCastOutput output;
+		if (b2ShapeCast(&output, &input))
+		{
+			fraction *= output.lambda;
+			result.fixture = fixture;
+			result.point = output.point;
+			result.normal = output.normal;
+			result.fraction = fraction;
+		}
+
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2DistanceProxy* shapeProxy;
+	b2AABB aabb;
+	b2Transform transform;
+	b2Vec2 translation;
+	float fraction;
+	b2RayCastHit result;
+};
+
+bool b2World::ShapeCast(const b2Shape* shape, const b2Transform& transform, const b2Vec2& translation, b2RayCastHit* hit) const
+{
+	b2DistanceProxy shapeProxy;
+	shapeProxy.Set(shape, 0);
+
+	b2WorldShapeCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.shapeProxy = &shapeProxy;
+	shape->ComputeAABB(&wrapper.aabb, transform, 0);
+	wrapper.transform = transform;
+	wrapper.translation = translation;
+	wrapper.fraction = 1.0f;
+	wrapper.result.fixture = nullptr;
+
+	b2AABB sweptAABB;
+	sweptAABB.lowerBound = wrapper.aabb.lowerBound + b2Min(b2Vec2_zero, translation);
+	sweptAABB.upperBound = wrapper.aabb.upperBound + b2Max(b2Vec2_zero, translation);
+	m_contactManager.m_broadPhase.Query(&wrapper, sweptAABB);
+
+	if (wrapper.result.fixture == nullptr)
+	{
+		return false;
+	}
+
+	*hit = wrapper.result;
+	return true;
+}
+
+void b2World::ShapeCastBatch(const b2ShapeCastQuery* queries, b2RayCastHit* hits, int32 count) const
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2ShapeCastQuery* query = queries + i;
+		if (ShapeCast(query->shape, query->transform, query->translation, hits + i) == false)
+		{
+			hits[i].fixture = nullptr;
+			hits[i].point = query->transform.p;
+			hits[i].normal.SetZero();
+			hits[i].fraction = 1.0f;
+		}
+	}
+}
+
+b2OverlapCache::b2OverlapCache()
+{
+	m_entries = nullptr;
+	m_count = 0;
+	m_capacity = 0;
+	m_nextEntries = nullptr;
+	m_nextCount = 0;
+	m_nextCapacity = 0;
+}
+
+b2OverlapCache::~b2OverlapCache()
+{
+	b2Free(m_entries);
+	b2Free(m_nextEntries);
+}
+
+void b2OverlapCache::Clear()
+{
+	m_count = 0;
+	m_nextCount = 0;
+}
+
+b2SimplexCache* b2OverlapCache::Find(const b2Fixture* fixture, int32 proxyId, int32 childIndex)
+{
+	// Binary search for the proxy. Proxy ids are reused, so check the fixture as well.
+	int32 low = 0;
+	int32 high = m_count - 1;
+	while (low <= high)
+	{
+		int32 mid = (low + high) >> 1;
+		Entry* entry = m_entries + mid;
+		if (entry->proxyId < proxyId)
+		{
+			low = mid + 1;
+		}
+		else if (entry->proxyId > proxyId)
+		{
+			high = mid - 1;
+		}
+		else if (entry->fixture == fixture && entry->childIndex == childIndex)
+		{
+			return &entry->cache;
+		}
+		else
+		{
+			return nullptr;
+		}
+	}
+
+	return nullptr;
+}
+
+b2SimplexCache* b2OverlapCache::Add(const b2Fixture* fixture, int32 proxyId, int32 childIndex, const b2SimplexCache& cache)
+{
+	if (m_nextCount == m_nextCapacity)
+	{
+		Entry* oldEntries = m_nextEntries;
+		m_nextCapacity = b2Max(2 * m_nextCapacity, 16);
+		m_nextEntries = (Entry*)b2Alloc(m_nextCapacity * sizeof(Entry));
+		if (oldEntries != nullptr)
+		{
+			memcpy(m_nextEntries, oldEntries, m_nextCount * sizeof(Entry));
+			b2Free(oldEntries);
+		}
+	}
+
+	Entry* entry = m_nextEntries + m_nextCount;
+	entry->fixture = fixture;
+	entry->proxyId = proxyId;
+	entry->childIndex = childIndex;
+	entry->cache = cache;
+	++m_nextCount;
+	return &entry->cache;
+}
+
+void b2OverlapCache::Swap()
+{
+	std::sort(m_nextEntries, m_nextEntries + m_nextCount);
+
+	b2Swap(m_entries, m_nextEntries);
+	b2Swap(m_capacity, m_nextCapacity);
+	m_count = m_nextCount;
+	m_nextCount = 0;
+}
+
+struct b2WorldOverlapWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (b2TestOverlap(aabb, proxy->aabb) == false)
+		{
+			return true;
+		}
+
+		b2Fixture* fixture = proxy->fixture;
+		if (filter != nullptr && b2TestFilter(fixture->GetFilterData(), *filter) == false)
+		{
+			return true;
+		}
+
+		b2DistanceInput input;
+		input.proxyA.Set(fixture->GetShape(), proxy->childIndex);
+		input.proxyB = *shapeProxy;
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB = transform;
+		input.useRadii = true;
+
+		b2SimplexCache localCache;
+		localCache.count = 0;
+
+		b2SimplexCache* simplexCache = &localCache;
+		if (cache != nullptr)
+		{
+			b2SimplexCache* oldCache = cache->Find(fixture, proxyId, proxy->childIndex);
+			simplexCache = cache->Add(fixture, proxyId, proxy->childIndex, oldCache != nullptr ? *oldCache : localCache);
+
+			// Drop a simplex that does not fit the current shapes.
+			for (int32 i = 0; i < simplexCache->count; ++i)
+			{
+				if (simplexCache->indexA[i] >= input.proxyA.m_count || simplexCache->indexB[i] >= input.proxyB.m_count)
+				{
+					simplexCache->count = 0;
+					break;
+				}
+			}
+		}
+
+		b2DistanceOutput output;
+		b2Distance(&output, simplexCache, &input);
+
+		if (output.distance >= 10.0f * b2_epsilon)
+		{
+			return true;
+		}
+
+		if (callback != nullptr)
+		{
+			return callback->ReportFixture(fixture);
+		}
+
+		// Batched query
+		if (hitCount < capacity)
+		{
+			hits[hitCount].queryIndex = queryIndex;
+			hits[hitCount].fixture = fixture;
+		}
+
+		++hitCount;
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2DistanceProxy* shapeProxy;
+	b2AABB aabb;
+	b2Transform transform;
+	const b2Filter* filter;
+	b2OverlapCache* cache;
+	b2QueryCallback* callback;
+	b2QueryHit* hits;
+	int32 capacity;
+	int32 hitCount;
+	int32 queryIndex;
+};
+
+void b2World::OverlapShape(b2QueryCallback* callback, const b2Shape* shape, const b2Transform& transform) const
+{
+	b2DistanceProxy shapeProxy;
+	shapeProxy.Set(shape, 0);
+
+	b2WorldOverlapWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.shapeProxy = &shapeProxy;
+	shape->ComputeAABB(&wrapper.aabb, transform, 0);
+	wrapper.transform = transform;
+	wrapper.filter = nullptr;
+	wrapper.cache = nullptr;
+	wrapper.callback = callback;
+	wrapper.hits = nullptr;
+	wrapper.capacity = 0;
+	wrapper.hitCount = 0;
+	wrapper.queryIndex = 0;
+	m_contactManager.m_broadPhase.Query(&wrapper, wrapper.aabb);
+}
+
+void b2World::OverlapShape(b2QueryCallback* callback, const b2Shape* shape, const b2Transform& transform,
+							const b2Filter& filter, b2OverlapCache* cache) const
+{
+	b2DistanceProxy shapeProxy;
+	shapeProxy.Set(shape, 0);
+
+	b2WorldOverlapWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.shapeProxy = &shapeProxy;
+	shape->ComputeAABB(&wrapper.aabb, transform, 0);
+	wrapper.transform = transform;
+	wrapper.filter = &filter;
+	wrapper.cache = cache;
+	wrapper.callback = callback;
+	wrapper.hits = nullptr;
+	wrapper.capacity = 0;
+	wrapper.hitCount = 0;
+	wrapper.queryIndex = 0;
+
+	if (filter.groupIndex > 0)
+	{
+		m_contactManager.m_broadPhase.Query(&wrapper, wrapper.aabb);
+	}
+	else
+	{
+		m_contactManager.m_broadPhase.Query(&wrapper, wrapper.aabb, filter.maskBits);
+	}
+
+	if (cache != nullptr)
+	{
+		cache->Swap();
+	}
+}
+
+int32 b2World::OverlapShapeBatch(const b2ShapeQuery* queries, int32 count, const b2Filter& filter,
+								b2QueryHit* hits, int32 capacity) const
+{
+	b2WorldOverlapWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.filter = &filter;
+	wrapper.cache = nullptr;
+	wrapper.callback = nullptr;
+	wrapper.hits = hits;
+	wrapper.capacity = capacity;
+	wrapper.hitCount = 0;
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2DistanceProxy shapeProxy;
+		shapeProxy.Set(queries[i].shape, 0);
+
+		wrapper.shapeProxy = &shapeProxy;
+		queries[i].shape->ComputeAABB(&wrapper.aabb, queries[i].transform, 0);
+		wrapper.transform = queries[i].transform;
+		wrapper.queryIndex = i;
+
+		if (filter.groupIndex > 0)
+		{
+			m_contactManager.m_broadPhase.Query(&wrapper, wrapper.aabb);
+		}
+		else
+		{
+			m_contactManager.m_broadPhase.Query(&wrapper, wrapper.aabb, filter.maskBits);
+		}
+	}
+
+	return wrapper.hitCount;
+}
+
+// Keeps the k nearest fixtures sorted by distance.
+struct b2WorldNearestWrapper
+{
+	float QueryNearestCallback(int32 proxyId, float maxDistance)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (b2DistanceSquared(proxy->aabb, point) > maxDistance * maxDistance)
+		{
+			return maxDistance;
+		}
+
+		b2Fixture* fixture = proxy->fixture;
+		if (filter != nullptr && b2TestFilter(fixture->GetFilterData(), *filter) == false)
+		{
+			return maxDistance;
+		}
+
+		b2DistanceInput input;
+		input.proxyA.Set(fixture->GetShape(), proxy->childIndex);
+		input.proxyB.Set(&point, 1, 0.0f);
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB.SetIdentity();
+		input.useRadii = true;
+
+		b2SimplexCache cache;
+		cache.count = 0;
+
+		b2DistanceOutput output;
+		b2Distance(&output, &cache, &input);
+
+		if (output.distance > maxDistance)
+		{
+			return maxDistance;
+		}
+
+		// Insertion sort, dropping the farthest hit when full.
+		int32 index = count < capacity ? count++ : capacity - 1;
+		while (index > 0 && hits[index - 1].distance > output.distance)
+		{
+			hits[index] = hits[index - 1];
+			--index;
+		}
+
+		hits[index].fixture = fixture;
+		hits[index].point = output.pointA;
+		hits[index].distance = output.distance;
+
+		// Once full, only fixtures closer than the farthest hit matter.
+		return count == capacity ? hits[capacity - 1].distance : maxDistance;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2Filter* filter;
+	b2Vec2 point;
+	b2NearestHit* hits;
+	int32 capacity;
+	int32 count;
+};
+
+bool b2World::NearestFixture(const b2Vec2& point, float maxDistance, b2NearestHit* hit) const
+{
+	b2NearestHit result;
+
+	b2WorldNearestWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.filter = nullptr;
+	wrapper.point = point;
+	wrapper.hits = &result;
+	wrapper.capacity = 1;
+	wrapper.count = 0;
+	m_contactManager.m_broadPhase.QueryNearest(&wrapper, point, maxDistance);
+
+	if (wrapper.count == 0)
+	{
+		return false;
+	}
+
+	*hit = result;
+	return true;
+}
+
+int32 b2World::NearestFixtures(const b2Vec2& point, float maxDistance, const b2Filter& filter, b2NearestHit* hits, int32 k) const
+{
+	b2Assert(k > 0);
+
+	b2WorldNearestWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.filter = &filter;
+	wrapper.point = point;
+	wrapper.hits = hits;
+	wrapper.capacity = k;
+	wrapper.count = 0;
+
+	if (filter.groupIndex > 0)
+	{
+		m_contactManager.m_broadPhase.QueryNearest(&wrapper, point, maxDistance);
+	}
+	else
+	{
+		m_contactManager.m_broadPhase.QueryNearest(&wrapper, point, maxDistance, filter.maskBits);
+	}
+
+	return wrapper.count;
 }
 
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
@@ -1102,6 +1935,40 @@ void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* capsule = (b2CapsuleShape*)fixture->GetShape();
+			b2Vec2 v1 = b2Mul(xf, capsule->m_center1);
+			b2Vec2 v2 = b2Mul(xf, capsule->m_center2);
+			float radius = capsule->m_radius;
+
+			// Outline made of two half circles.
+			const int32 k_segments = 8;
+			b2Vec2 vertices[2 * k_segments + 2];
+
+			b2Vec2 axis = v2 - v1;
+			axis.Normalize();
+			b2Rot q(b2_pi / k_segments);
+			b2Vec2 normal = radius * b2Cross(axis, 1.0f);
+			b2Vec2 r = normal;
+			for (int32 i = 0; i <= k_segments; ++i)
+			{
+				vertices[i] = v2 + r;
+				r = b2Mul(q, r);
+			}
+
+			r = -normal;
+			for (int32 i = 0; i <= k_segments; ++i)
+			{
+				vertices[k_segments + 1 + i] = v1 + r;
+				r = b2Mul(q, r);
+			}
+
+			m_debugDraw->DrawSolidPolygon(vertices, 2 * k_segments + 2, color);
+			m_debugDraw->DrawSegment(v1, v2, color);
+		}
+		break;
+
 	default:
 	break;
 	}
@@ -1217,6 +2084,77 @@ void b2World::DebugDraw()
 	}
 }
 
+void b2World::SetBroadPhaseType(b2BroadPhaseType type)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	const b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	if (type == broadPhase->GetType())
+	{
+		return;
+	}
+
+	RebuildBroadPhase(type, broadPhase->GetGridCellSize());
+}
+
+void b2World::SetGridCellSize(float cellSize)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	b2Assert(cellSize > 0.0f);
+	const b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	if (cellSize == broadPhase->GetGridCellSize())
+	{
+		return;
+	}
+
+	RebuildBroadPhase(broadPhase->GetType(), cellSize);
+}
+
+void b2World::RebuildBroadPhase(b2BroadPhaseType type, float gridCellSize)
+{
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+
+	// Proxy ids are not portable between structures, so rebuild the proxies.
+	// Contacts refer to fixtures, not proxies, so they survive.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			f->DestroyProxies(broadPhase);
+		}
+	}
+
+	broadPhase->SetType(type);
+	broadPhase->SetGridCellSize(gridCellSize);
+
+	// The move buffer was cleared.
+	++m_moveEpoch;
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			f->CreateProxies(broadPhase, b->m_xf);
+		}
+	}
+
+	m_newContacts = true;
+}
+
 int32 b2World::GetProxyCount() const
 {
 	return m_contactManager.m_broadPhase.GetProxyCount();
@@ -1257,9 +2195,77 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 		j->ShiftOrigin(newOrigin);
 	}
 
+	for (b2PersistentQuery* q = m_queryList; q; q = q->m_next)
+	{
+		q->m_aabb.lowerBound -= newOrigin;
+		q->m_aabb.upperBound -= newOrigin;
+	}
+
 	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 }
 
+void b2World::SetLayerCollision(int32 layerA, int32 layerB, bool flag)
+{
+	b2Assert(m_locked == false);
+	if (m_locked)
+	{
+		return;
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	if (broadPhase->GetLayerCollision(layerA, layerB) == flag)
+	{
+		return;
+	}
+
+	broadPhase->SetLayerCollision(layerA, layerB, flag);
+
+	// Destroy contacts that are now disabled and find pairs that are now enabled.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			f->Refilter();
+		}
+	}
+}
+
+bool b2World::GetLayerCollision(int32 layerA, int32 layerB) const
+{
+	return m_contactManager.m_broadPhase.GetLayerCollision(layerA, layerB);
+}
+
+int32 b2World::GetRejectedPairCount() const
+{
+	return m_contactManager.m_broadPhase.GetRejectedPairCount();
+}
+
+void b2World::SetManifoldReuse(bool flag)
+{
+	m_contactManager.m_manifoldReuse = flag;
+}
+
+bool b2World::GetManifoldReuse() const
+{
+	return m_contactManager.m_manifoldReuse;
+}
+
+int32 b2World::GetReusedManifoldCount() const
+{
+	return m_contactManager.m_reusedManifoldCount;
+}
+
+void b2World::RelayoutBroadPhase()
+{
+	b2Assert(m_locked == false);
+	if (m_locked)
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.Relayout();
+}
+
 void b2World::Dump()
 {
 	if (m_locked)
@@ -305,6 +305,8 @@ void Test::Step(Settings& settings)
 	m_world->SetWarmStarting(settings.m_enableWarmStarting);
 	m_world->SetContinuousPhysics(settings.m_enableContinuous);
 	m_world->SetSubStepping(settings.m_enableSubStepping);
+	m_world->SetManifoldReuse(settings.m_enableManifoldReuse);
+	m_world->SetSpeculativeContacts(settings.m_enableSpeculative);
 
 	m_pointCount = 0;
 
@@ -332,6 +334,12 @@ void Test::Step(Settings& settings)
 		float quality = m_world->GetTreeQuality();
 		g_debugDraw.DrawString(5, m_textLine, "proxies/height/balance/quality = %d/%d/%d/%g", proxyCount, height, balance, quality);
 		m_textLine += m_textIncrement;
+
+		if (m_world->GetManifoldReuse())
+		{
+			g_debugDraw.DrawString(5, m_textLine, "reused manifolds = %d", m_world->GetReusedManifoldCount());
+			m_textLine += m_textIncrement;
+		}
 	}
 
 	// Track maximum profile times
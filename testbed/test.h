@@ -27,6 +27,7 @@
 #include "draw.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 struct Settings;
 class Test;
@@ -0,0 +1,148 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "test.h"
+
+// This drops a pile of capsules into a box. Press (c) to rebuild the pile with polygons
+// shaped like capsules and compare the collide time.
+class CapsuleStack : public Test
+{
+public:
+
+	enum
+	{
+		e_columnCount = 20,
+		e_rowCount = 30
+	};
+
+	CapsuleStack()
+	{
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2EdgeShape shape;
+			shape.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+			shape.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(-20.0f, 60.0f));
+			ground->CreateFixture(&shape, 0.0f);
+			shape.SetTwoSided(b2Vec2(20.0f, 0.0f), b2Vec2(20.0f, 60.0f));
+			ground->CreateFixture(&shape, 0.0f);
+		}
+
+		for (int32 i = 0; i < e_columnCount * e_rowCount; ++i)
+		{
+			m_bodies[i] = nullptr;
+		}
+
+		m_usePolygons = false;
+		m_collideTime = 0.0f;
+		CreatePile();
+	}
+
+	void CreatePile()
+	{
+		for (int32 i = 0; i < e_columnCount * e_rowCount; ++i)
+		{
+			if (m_bodies[i] != nullptr)
+			{
+				m_world->DestroyBody(m_bodies[i]);
+			}
+		}
+
+		b2CapsuleShape capsule;
+		capsule.Set(b2Vec2(-0.5f, 0.0f), b2Vec2(0.5f, 0.0f), 0.25f);
+
+		// The polygon has three vertices on each round end.
+		b2PolygonShape polygon;
+		{
+			b2Vec2 vertices[8];
+			for (int32 i = 0; i < 4; ++i)
+			{
+				float angle = -0.5f * b2_pi + i * b2_pi / 3.0f;
+				vertices[i].Set(0.5f + 0.25f * cosf(angle), 0.25f * sinf(angle));
+				vertices[i + 4].Set(-0.5f - 0.25f * cosf(angle), -0.25f * sinf(angle));
+			}
+			polygon.Set(vertices, 8);
+		}
+
+		for (int32 i = 0; i < e_columnCount; ++i)
+		{
+			for (int32 j = 0; j < e_rowCount; ++j)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position.Set(-18.0f + 1.8f * i, 1.0f + 0.8f * j);
+				bd.angle = 0.3f * ((i + j) % 5);
+				b2Body* body = m_world->CreateBody(&bd);
+
+				if (m_usePolygons)
+				{
+					body->CreateFixture(&polygon, 1.0f);
+				}
+				else
+				{
+					body->CreateFixture(&capsule, 1.0f);
+				}
+
+				m_bodies[i * e_rowCount + j] = body;
+			}
+		}
+	}
+
+	void Keyboard(int key) override
+	{
+		switch (key)
+		{
+		case GLFW_KEY_C:
+			m_usePolygons = !m_usePolygons;
+			m_collideTime = 0.0f;
+			CreatePile();
+			break;
+		}
+	}
+
+	void Step(Settings& settings) override
+	{
+		Test::Step(settings);
+
+		// Smooth the collide time so that the two shapes can be compared.
+		const b2Profile& profile = m_world->GetProfile();
+		m_collideTime = 0.95f * m_collideTime + 0.05f * profile.collide;
+
+		g_debugDraw.DrawString(5, m_textLine, "Press (c) to switch between capsules and polygons.");
+		m_textLine += m_textIncrement;
+		g_debugDraw.DrawString(5, m_textLine, "Polygons = %d, collide time = %5.3f ms", m_usePolygons, m_collideTime);
+		m_textLine += m_textIncrement;
+	}
+
+	static Test* Create()
+	{
+		return new CapsuleStack;
+	}
+
+	b2Body* m_bodies[e_columnCount * e_rowCount];
+	bool m_usePolygons;
+	float m_collideTime;
+};
+
+static int testIndex = RegisterTest("Stacking", "Capsules", CapsuleStack::Create);
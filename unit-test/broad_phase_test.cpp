@@ -0,0 +1,481 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/box2d.h"
+#include "doctest.h"
+#include <stdio.h>
+#include <set>
+#include <utility>
+
+namespace
+{
+
+// Deterministic random numbers so that failures are reproducible.
+struct TestRandom
+{
+	uint32 state = 12345;
+
+	float Get(float lo, float hi)
+	{
+		state = 1664525u * state + 1013904223u;
+		float t = float(state >> 8) / float(1 << 24);
+		return lo + t * (hi - lo);
+	}
+};
+
+typedef std::set<std::pair<int32, int32>> PairSet;
+
+struct PairCollector
+{
+	void AddPair(void* userDataA, void* userDataB)
+	{
+		int32 a = int32(uintptr_t(userDataA));
+		int32 b = int32(uintptr_t(userDataB));
+		pairs.insert(std::make_pair(b2Min(a, b), b2Max(a, b)));
+	}
+
+	PairSet pairs;
+};
+
+struct QueryCollector
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		items.insert(int32(uintptr_t(broadPhase->GetUserData(proxyId))));
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	std::set<int32> items;
+};
+
+struct RayCollector
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		items.insert(int32(uintptr_t(broadPhase->GetUserData(proxyId))));
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	std::set<int32> items;
+};
+
+struct TreeCollector
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		items.insert(int32(uintptr_t(tree->GetUserData(proxyId))));
+		return int32(items.size()) < limit;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		items.insert(int32(uintptr_t(tree->GetUserData(proxyId))));
+		return input.maxFraction;
+	}
+
+	const b2DynamicTree* tree;
+	std::set<int32> items;
+	int32 limit = 1 << 30;
+};
+
+const int32 e_proxyCount = 200;
+
+// Build the same scene in a broad-phase and return the pairs found in two updates.
+void RunScene(b2BroadPhase* broadPhase, int32* proxyIds, PairSet* pairs1, PairSet* pairs2)
+{
+	TestRandom random;
+
+	for (int32 i = 0; i < e_proxyCount; ++i)
+	{
+		b2AABB aabb;
+		aabb.lowerBound.Set(random.Get(-100.0f, 100.0f), random.Get(-5.0f, 5.0f));
+		aabb.upperBound = aabb.lowerBound + b2Vec2(random.Get(0.1f, 2.0f), random.Get(0.1f, 2.0f));
+		if (i % 25 == 0)
+		{
+			// Some large proxies, like ground boxes.
+			aabb.upperBound.x += 30.0f;
+		}
+
+		proxyIds[i] = broadPhase->CreateProxy(aabb, (void*)uintptr_t(i));
+	}
+
+	PairCollector collector1;
+	broadPhase->UpdatePairs(&collector1);
+	*pairs1 = collector1.pairs;
+
+	// Move a few proxies far enough to leave their fat AABBs.
+	for (int32 i = 0; i < e_proxyCount; i += 7)
+	{
+		b2AABB aabb = broadPhase->GetFatAABB(proxyIds[i]);
+		b2Vec2 d(random.Get(-3.0f, 3.0f), random.Get(-1.0f, 1.0f));
+		aabb.lowerBound += d;
+		aabb.upperBound += d;
+		broadPhase->MoveProxy(proxyIds[i], aabb, d);
+	}
+
+	PairCollector collector2;
+	broadPhase->UpdatePairs(&collector2);
+	*pairs2 = collector2.pairs;
+}
+
+// Compare a broad-phase structure against the dynamic tree.
+void CheckMatchesTree(b2BroadPhaseType type)
+{
+	b2BroadPhase tree;
+	int32 treeIds[e_proxyCount];
+	PairSet treePairs1, treePairs2;
+	RunScene(&tree, treeIds, &treePairs1, &treePairs2);
+
+	b2BroadPhase other;
+	other.SetType(type);
+	int32 otherIds[e_proxyCount];
+	PairSet otherPairs1, otherPairs2;
+	RunScene(&other, otherIds, &otherPairs1, &otherPairs2);
+
+	CHECK(treePairs1.size() > 0);
+	CHECK(treePairs2.size() > 0);
+	CHECK(treePairs1 == otherPairs1);
+	CHECK(treePairs2 == otherPairs2);
+
+	b2AABB box;
+	box.lowerBound.Set(-20.0f, -2.0f);
+	box.upperBound.Set(15.0f, 3.0f);
+
+	QueryCollector treeQuery;
+	treeQuery.broadPhase = &tree;
+	tree.Query(&treeQuery, box);
+
+	QueryCollector otherQuery;
+	otherQuery.broadPhase = &other;
+	other.Query(&otherQuery, box);
+
+	CHECK(treeQuery.items.size() > 0);
+	CHECK(treeQuery.items == otherQuery.items);
+
+	b2RayCastInput input;
+	input.p1.Set(90.0f, -3.0f);
+	input.p2.Set(-90.0f, 4.0f);
+	input.maxFraction = 1.0f;
+
+	RayCollector treeRay;
+	treeRay.broadPhase = &tree;
+	tree.RayCast(&treeRay, input);
+
+	RayCollector otherRay;
+	otherRay.broadPhase = &other;
+	other.RayCast(&otherRay, input);
+
+	CHECK(treeRay.items.size() > 0);
+	CHECK(treeRay.items == otherRay.items);
+
+	for (int32 i = 0; i < e_proxyCount; i += 2)
+	{
+		tree.DestroyProxy(treeIds[i]);
+		other.DestroyProxy(otherIds[i]);
+	}
+
+	CHECK(other.GetProxyCount() == e_proxyCount / 2);
+
+	QueryCollector treeQuery2;
+	treeQuery2.broadPhase = &tree;
+	tree.Query(&treeQuery2, box);
+
+	QueryCollector otherQuery2;
+	otherQuery2.broadPhase = &other;
+	other.Query(&otherQuery2, box);
+
+	CHECK(treeQuery2.items == otherQuery2.items);
+}
+
+}
+
+DOCTEST_TEST_CASE("broad-phase test")
+{
+	SUBCASE("tree traversal")
+	{
+		// Proxies inserted along a line, then rebuilt, give a deep tree.
+		b2DynamicTree tree;
+		b2AABB aabbs[e_proxyCount];
+		TestRandom random;
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			float x = 0.5f * i;
+			aabbs[i].lowerBound.Set(x, x + random.Get(-1.0f, 1.0f));
+			aabbs[i].upperBound = aabbs[i].lowerBound + b2Vec2(1.0f, 1.0f);
+			int32 proxyId = tree.CreateProxy(aabbs[i], (void*)uintptr_t(i));
+			aabbs[i] = tree.GetFatAABB(proxyId);
+		}
+
+		tree.RebuildBottomUp();
+
+		b2AABB box;
+		box.lowerBound.Set(20.0f, 10.0f);
+		box.upperBound.Set(45.0f, 60.0f);
+
+		TreeCollector query;
+		query.tree = &tree;
+		tree.Query(&query, box);
+
+		std::set<int32> expected;
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			if (b2TestOverlap(aabbs[i], box))
+			{
+				expected.insert(i);
+			}
+		}
+
+		CHECK(expected.size() > 0);
+		CHECK(query.items == expected);
+
+		// The query stops when the callback returns false.
+		TreeCollector limited;
+		limited.tree = &tree;
+		limited.limit = 3;
+		tree.Query(&limited, box);
+		CHECK(limited.items.size() == 3);
+
+		b2RayCastInput input;
+		input.p1.Set(-10.0f, 30.0f);
+		input.p2.Set(110.0f, 30.0f);
+		input.maxFraction = 1.0f;
+
+		TreeCollector ray;
+		ray.tree = &tree;
+		tree.RayCast(&ray, input);
+
+		expected.clear();
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			b2RayCastOutput output;
+			if (aabbs[i].RayCast(&output, input))
+			{
+				expected.insert(i);
+			}
+		}
+
+		CHECK(expected.size() > 0);
+		CHECK(ray.items == expected);
+	}
+
+	SUBCASE("tree relayout")
+	{
+		b2DynamicTree tree;
+		int32 proxyIds[e_proxyCount];
+		TestRandom random;
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			b2AABB aabb;
+			aabb.lowerBound.Set(random.Get(-50.0f, 50.0f), random.Get(-50.0f, 50.0f));
+			aabb.upperBound = aabb.lowerBound + b2Vec2(1.0f, 1.0f);
+			proxyIds[i] = tree.CreateProxy(aabb, (void*)uintptr_t(i));
+		}
+
+		// Scatter the node pool with moves and removals.
+		for (int32 i = 0; i < e_proxyCount; i += 3)
+		{
+			b2AABB aabb = tree.GetFatAABB(proxyIds[i]);
+			b2Vec2 d(random.Get(-10.0f, 10.0f), random.Get(-10.0f, 10.0f));
+			aabb.lowerBound += d;
+			aabb.upperBound += d;
+			tree.MoveProxy(proxyIds[i], aabb, d);
+		}
+
+		for (int32 i = 1; i < e_proxyCount; i += 4)
+		{
+			tree.DestroyProxy(proxyIds[i]);
+			proxyIds[i] = b2_nullNode;
+		}
+
+		b2AABB box;
+		box.lowerBound.Set(-20.0f, -20.0f);
+		box.upperBound.Set(25.0f, 10.0f);
+
+		TreeCollector before;
+		before.tree = &tree;
+		tree.Query(&before, box);
+
+		b2AABB fatAABBs[e_proxyCount];
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			if (proxyIds[i] != b2_nullNode)
+			{
+				fatAABBs[i] = tree.GetFatAABB(proxyIds[i]);
+			}
+		}
+
+		int32 height = tree.GetHeight();
+		tree.Relayout();
+		tree.Validate();
+
+		CHECK(tree.GetHeight() == height);
+
+		TreeCollector after;
+		after.tree = &tree;
+		tree.Query(&after, box);
+
+		CHECK(before.items.size() > 0);
+		CHECK(after.items == before.items);
+
+		for (int32 i = 0; i < e_proxyCount; ++i)
+		{
+			if (proxyIds[i] != b2_nullNode)
+			{
+				CHECK(int32(uintptr_t(tree.GetUserData(proxyIds[i]))) == i);
+				CHECK(tree.GetFatAABB(proxyIds[i]).lowerBound == fatAABBs[i].lowerBound);
+				CHECK(tree.GetFatAABB(proxyIds[i]).upperBound == fatAABBs[i].upperBound);
+			}
+		}
+
+		// The tree keeps working after the relayout.
+		for (int32 i = 1; i < e_proxyCount; i += 4)
+		{
+			proxyIds[i] = tree.CreateProxy(box, (void*)uintptr_t(i));
+		}
+
+		tree.Validate();
+
+		TreeCollector grown;
+		grown.tree = &tree;
+		tree.Query(&grown, box);
+		CHECK(grown.items.size() > after.items.size());
+	}
+
+	SUBCASE("sweep and prune matches tree")
+	{
+		CheckMatchesTree(b2_sweepAndPruneBroadPhase);
+	}
+
+	SUBCASE("grid matches tree")
+	{
+		CheckMatchesTree(b2_gridBroadPhase);
+	}
+
+	SUBCASE("world broad-phase type")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+
+		b2BodyDef groundDef;
+		b2Body* ground = world.CreateBody(&groundDef);
+		b2EdgeShape edge;
+		edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+		ground->CreateFixture(&edge, 0.0f);
+
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		for (int32 i = 0; i < 10; ++i)
+		{
+			bodyDef.position.Set(-20.0f + 4.0f * i, 0.6f);
+			world.CreateBody(&bodyDef)->CreateFixture(&box, 1.0f);
+		}
+
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world.GetContactCount() == 10);
+
+		world.SetBroadPhaseType(b2_sweepAndPruneBroadPhase);
+		CHECK(world.GetBroadPhaseType() == b2_sweepAndPruneBroadPhase);
+		CHECK(world.GetProxyCount() == 11);
+		CHECK(world.GetContactCount() == 10);
+
+		for (int32 i = 0; i < 60; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		CHECK(world.GetContactCount() == 10);
+
+		bodyDef.position.Set(30.0f, 5.0f);
+		world.CreateBody(&bodyDef)->CreateFixture(&box, 1.0f);
+
+		for (int32 i = 0; i < 120; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		CHECK(world.GetContactCount() == 11);
+
+		world.SetBroadPhaseType(b2_gridBroadPhase);
+		world.SetGridCellSize(1.5f);
+		CHECK(world.GetGridCellSize() == 1.5f);
+		CHECK(world.GetProxyCount() == 12);
+
+		bodyDef.position.Set(-30.0f, 5.0f);
+		world.CreateBody(&bodyDef)->CreateFixture(&box, 1.0f);
+
+		for (int32 i = 0; i < 120; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		CHECK(world.GetContactCount() == 12);
+	}
+
+	SUBCASE("world layer matrix")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		world.SetLayerCollision(0, 3, false);
+		CHECK(world.GetLayerCollision(3, 0) == false);
+		CHECK(world.GetLayerCollision(0, 0));
+
+		b2BodyDef groundDef;
+		b2Body* ground = world.CreateBody(&groundDef);
+		b2EdgeShape edge;
+		edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+		ground->CreateFixture(&edge, 0.0f);
+
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+
+		b2FixtureDef fixtureDef;
+		fixtureDef.shape = &box;
+		fixtureDef.density = 1.0f;
+
+		// Odd boxes are in layer 3, which does not collide with the ground.
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		for (int32 i = 0; i < 10; ++i)
+		{
+			bodyDef.position.Set(-20.0f + 4.0f * i, 0.6f);
+			fixtureDef.filter.layer = i % 2 == 0 ? 0 : 3;
+			world.CreateBody(&bodyDef)->CreateFixture(&fixtureDef);
+		}
+
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world.GetContactCount() == 5);
+		CHECK(world.GetRejectedPairCount() == 5);
+
+		world.SetLayerCollision(0, 3, true);
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world.GetContactCount() == 10);
+		CHECK(world.GetRejectedPairCount() == 0);
+
+		// Disabling the layers again removes the existing contacts.
+		world.SetLayerCollision(3, 0, false);
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world.GetContactCount() == 5);
+	}
+}
@@ -78,4 +78,506 @@ DOCTEST_TEST_CASE("collision test")
 		CHECK(b2Abs(massData2.mass - mass) < 20.0f * (absTol + relTol * mass));
 		CHECK(b2Abs(massData2.I - inertia) < 40.0f * (absTol + relTol * inertia));
 	}
+
+	SUBCASE("polygon collider")
+	{
+		// The SIMD and scalar colliders must agree exactly.
+		uint32 seed = 12345;
+		b2PolygonShape polygons[16];
+		for (int32 i = 0; i < 16; ++i)
+		{
+			int32 count = 3 + i % (b2_maxPolygonVertices - 2);
+			b2Vec2 points[b2_maxPolygonVertices];
+			for (int32 j = 0; j < count; ++j)
+			{
+				seed = 1664525 * seed + 1013904223;
+				float radius = 0.8f + 0.4f * float(seed >> 8) / float(1 << 24);
+				float angle = 2.0f * b2_pi * float(j) / float(count);
+				points[j].Set(radius * cosf(angle), 0.5f * radius * sinf(angle));
+			}
+
+			polygons[i].Set(points, count);
+		}
+
+		int32 touchingCount = 0;
+		for (int32 i = 0; i < 16; ++i)
+		{
+			for (int32 j = 0; j < 16; ++j)
+			{
+				for (int32 k = 0; k < 8; ++k)
+				{
+					b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.1f * i));
+					b2Transform xfB(b2Vec2(-2.0f + 0.5f * k, 0.2f * j - 1.5f), b2Rot(0.7f * k + 0.3f * j));
+
+					b2Manifold manifold1, manifold2;
+					b2_simdCollision = true;
+					b2CollidePolygons(&manifold1, polygons + i, xfA, polygons + j, xfB);
+					b2_simdCollision = false;
+					b2CollidePolygons(&manifold2, polygons + i, xfA, polygons + j, xfB);
+					b2_simdCollision = true;
+
+					REQUIRE(manifold1.pointCount == manifold2.pointCount);
+					if (manifold1.pointCount == 0)
+					{
+						continue;
+					}
+
+					++touchingCount;
+					CHECK(manifold1.type == manifold2.type);
+					CHECK(manifold1.localNormal == manifold2.localNormal);
+					CHECK(manifold1.localPoint == manifold2.localPoint);
+					for (int32 p = 0; p < manifold1.pointCount; ++p)
+					{
+						CHECK(manifold1.points[p].localPoint == manifold2.points[p].localPoint);
+						CHECK(manifold1.points[p].id.key == manifold2.points[p].id.key);
+					}
+				}
+			}
+		}
+
+		CHECK(touchingCount > 100);
+	}
+
+	SUBCASE("box collider")
+	{
+		// The box colliders must agree with the general polygon collider.
+		b2PolygonShape boxes[4];
+		boxes[0].SetAsBox(0.5f, 0.5f);
+		boxes[1].SetAsBox(1.0f, 0.25f);
+		boxes[2].SetAsBox(0.3f, 0.7f, b2Vec2(0.2f, -0.1f), 0.4f);
+		boxes[3].SetAsBox(2.0f, 0.1f, b2Vec2(-0.5f, 0.3f), -1.2f);
+
+		b2CircleShape circle;
+		circle.m_p.Set(0.1f, 0.2f);
+		circle.m_radius = 0.4f;
+
+		int32 touchingCount = 0;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			CHECK(boxes[i].m_isBox);
+			b2Vec2 extents = boxes[i].GetBoxExtents();
+			CHECK(extents.x > 0.0f);
+			CHECK(extents.y > 0.0f);
+
+			for (int32 j = 0; j < 4; ++j)
+			{
+				for (int32 k = 0; k < 64; ++k)
+				{
+					b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.37f * i));
+					b2Transform xfB(b2Vec2(-1.5f + 0.05f * k, 0.6f * sinf(0.3f * k)), b2Rot(0.11f * k + 0.5f * j));
+
+					b2Manifold manifold1, manifold2;
+					b2_boxCollision = true;
+					b2CollidePolygons(&manifold1, boxes + i, xfA, boxes + j, xfB);
+					b2_boxCollision = false;
+					b2CollidePolygons(&manifold2, boxes + i, xfA, boxes + j, xfB);
+
+					REQUIRE(manifold1.pointCount == manifold2.pointCount);
+					if (manifold1.pointCount > 0)
+					{
+						++touchingCount;
+						CHECK(manifold1.type == manifold2.type);
+						CHECK(b2Distance(manifold1.localNormal, manifold2.localNormal) < b2_linearSlop);
+						for (int32 p = 0; p < manifold1.pointCount; ++p)
+						{
+							CHECK(b2Distance(manifold1.points[p].localPoint, manifold2.points[p].localPoint) < b2_linearSlop);
+							CHECK(manifold1.points[p].id.key == manifold2.points[p].id.key);
+						}
+					}
+
+					b2_boxCollision = true;
+					b2CollidePolygonAndCircle(&manifold1, boxes + i, xfA, &circle, xfB);
+					b2_boxCollision = false;
+					b2CollidePolygonAndCircle(&manifold2, boxes + i, xfA, &circle, xfB);
+					b2_boxCollision = true;
+
+					REQUIRE(manifold1.pointCount == manifold2.pointCount);
+					if (manifold1.pointCount > 0)
+					{
+						CHECK(b2Distance(manifold1.localNormal, manifold2.localNormal) < b2_linearSlop);
+						CHECK(b2Distance(manifold1.localPoint, manifold2.localPoint) < b2_linearSlop);
+					}
+				}
+			}
+		}
+
+		CHECK(touchingCount > 100);
+
+		// A general polygon is not a box.
+		b2Vec2 points[4] = { b2Vec2(-1.0f, -1.0f), b2Vec2(1.0f, -1.0f), b2Vec2(1.0f, 1.0f), b2Vec2(-1.0f, 1.0f) };
+		b2PolygonShape polygon;
+		polygon.Set(points, 4);
+		CHECK(polygon.m_isBox == false);
+	}
+
+	SUBCASE("specialized collider")
+	{
+		// The colliders specialized on vertex count must agree exactly with the general one.
+		const int32 counts[4] = { 3, 4, 5, 8 };
+		b2PolygonShape polygons[4];
+		for (int32 i = 0; i < 4; ++i)
+		{
+			b2Vec2 points[b2_maxPolygonVertices];
+			for (int32 j = 0; j < counts[i]; ++j)
+			{
+				float angle = 2.0f * b2_pi * float(j) / float(counts[i]) + 0.1f;
+				points[j].Set(cosf(angle), 0.6f * sinf(angle));
+			}
+
+			polygons[i].Set(points, counts[i]);
+			REQUIRE(polygons[i].m_count == counts[i]);
+		}
+
+		CHECK(b2GetPolygonCollider(5, 4) == b2CollidePolygons);
+		CHECK(b2GetPolygonCollider(4, 4) != b2CollidePolygons);
+
+		int32 touchingCount = 0;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			for (int32 j = 0; j < 4; ++j)
+			{
+				b2CollidePolygonsFcn* collider = b2GetPolygonCollider(counts[i], counts[j]);
+				for (int32 k = 0; k < 32; ++k)
+				{
+					b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.2f * i));
+					b2Transform xfB(b2Vec2(-1.6f + 0.1f * k, 0.5f * sinf(0.4f * k)), b2Rot(0.13f * k + 0.4f * j));
+
+					b2Manifold manifold1, manifold2;
+					collider(&manifold1, polygons + i, xfA, polygons + j, xfB);
+					b2CollidePolygons(&manifold2, polygons + i, xfA, polygons + j, xfB);
+
+					REQUIRE(manifold1.pointCount == manifold2.pointCount);
+					if (manifold1.pointCount == 0)
+					{
+						continue;
+					}
+
+					++touchingCount;
+					CHECK(manifold1.type == manifold2.type);
+					CHECK(manifold1.localNormal == manifold2.localNormal);
+					CHECK(manifold1.localPoint == manifold2.localPoint);
+					for (int32 p = 0; p < manifold1.pointCount; ++p)
+					{
+						CHECK(manifold1.points[p].localPoint == manifold2.points[p].localPoint);
+						CHECK(manifold1.points[p].id.key == manifold2.points[p].id.key);
+					}
+				}
+			}
+		}
+
+		CHECK(touchingCount > 100);
+	}
+
+	SUBCASE("capsule shape")
+	{
+		b2CapsuleShape capsule;
+		capsule.Set(b2Vec2(-1.0f, 0.0f), b2Vec2(1.0f, 0.0f), 0.5f);
+
+		// A capsule is a 2 by 1 rectangle plus a circle.
+		b2MassData massData;
+		capsule.ComputeMass(&massData, 1.0f);
+		CHECK(massData.mass == doctest::Approx(2.0f + 0.25f * b2_pi));
+		CHECK(massData.center.x == doctest::Approx(0.0f));
+		CHECK(massData.center.y == doctest::Approx(0.0f));
+
+		// Rectangle plus two half discs. Each half disc centroid is 4r/(3pi) beyond
+		// the end of the rectangle.
+		float radius = 0.5f;
+		float halfLength = 1.0f;
+		float rectMass = 2.0f * halfLength * 2.0f * radius;
+		float rectInertia = rectMass * (4.0f * halfLength * halfLength + 4.0f * radius * radius) / 12.0f;
+		float halfDiscMass = 0.5f * b2_pi * radius * radius;
+		float offset = 4.0f * radius / (3.0f * b2_pi);
+		float halfDiscInertia = halfDiscMass * (0.5f * radius * radius - offset * offset);
+		float distance = halfLength + offset;
+		float inertia = rectInertia + 2.0f * (halfDiscInertia + halfDiscMass * distance * distance);
+		CHECK(massData.I == doctest::Approx(inertia));
+
+		// Away from the origin the inertia includes the offset of the center.
+		b2CapsuleShape offsetCapsule;
+		offsetCapsule.Set(b2Vec2(1.0f, 2.0f), b2Vec2(3.0f, 2.0f), 0.5f);
+		b2MassData offsetMassData;
+		offsetCapsule.ComputeMass(&offsetMassData, 1.0f);
+		CHECK(offsetMassData.center.x == doctest::Approx(2.0f));
+		CHECK(offsetMassData.center.y == doctest::Approx(2.0f));
+		CHECK(offsetMassData.I == doctest::Approx(inertia + offsetMassData.mass * 8.0f));
+
+		b2Transform xf(b2Vec2(0.0f, 0.0f), b2Rot(0.0f));
+		CHECK(capsule.TestPoint(xf, b2Vec2(1.4f, 0.0f)));
+		CHECK(capsule.TestPoint(xf, b2Vec2(1.4f, 0.4f)) == false);
+
+		// Hit the side, then a round end.
+		b2RayCastInput input;
+		input.p1.Set(0.5f, 2.0f);
+		input.p2.Set(0.5f, -2.0f);
+		input.maxFraction = 1.0f;
+		b2RayCastOutput output;
+		REQUIRE(capsule.RayCast(&output, input, xf, 0));
+		CHECK(output.fraction == doctest::Approx(0.375f));
+		CHECK(output.normal.y == doctest::Approx(1.0f));
+
+		input.p1.Set(3.0f, 0.0f);
+		input.p2.Set(-3.0f, 0.0f);
+		REQUIRE(capsule.RayCast(&output, input, xf, 0));
+		CHECK(output.fraction == doctest::Approx(0.25f));
+		CHECK(output.normal.x == doctest::Approx(1.0f));
+
+		// Lying on top of each other gives two points, end to end gives one.
+		b2Manifold manifold;
+		b2CollideCapsules(&manifold, &capsule, xf, &capsule, b2Transform(b2Vec2(0.5f, 0.99f), b2Rot(0.0f)));
+		CHECK(manifold.pointCount == 2);
+
+		b2CollideCapsules(&manifold, &capsule, xf, &capsule, b2Transform(b2Vec2(2.99f, 0.0f), b2Rot(0.0f)));
+		CHECK(manifold.pointCount == 1);
+		CHECK(manifold.type == b2Manifold::e_circles);
+
+		b2CollideCapsules(&manifold, &capsule, xf, &capsule, b2Transform(b2Vec2(3.01f, 0.0f), b2Rot(0.0f)));
+		CHECK(manifold.pointCount == 0);
+
+		// A box corner against a round end only touches within the radius.
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+		b2Vec2 corner(0.5f, 0.5f);
+		b2Vec2 direction(1.0f, 1.0f);
+		direction.Normalize();
+		b2Transform xfB;
+		xfB.q.Set(0.25f * b2_pi);
+		xfB.p = corner + (0.49f + box.m_radius) * direction - b2Mul(xfB.q, b2Vec2(-1.0f, 0.0f));
+		b2CollidePolygonAndCapsule(&manifold, &box, xf, &capsule, xfB);
+		CHECK(manifold.pointCount == 1);
+
+		xfB.p = corner + (0.52f + box.m_radius) * direction - b2Mul(xfB.q, b2Vec2(-1.0f, 0.0f));
+		b2CollidePolygonAndCapsule(&manifold, &box, xf, &capsule, xfB);
+		CHECK(manifold.pointCount == 0);
+	}
+
+	SUBCASE("hill climbing support")
+	{
+		// Hill climbing must find the same support value as testing every vertex, also
+		// for directions perpendicular to an edge. The proxy does not need a polygon
+		// shape, so this runs with any vertex limit.
+		const int32 count = 24;
+		b2Vec2 points[count];
+		for (int32 j = 0; j < count; ++j)
+		{
+			float angle = 2.0f * b2_pi * (float(j) + 0.5f) / float(count);
+			points[j].Set(cosf(angle), sinf(angle));
+		}
+
+		b2DistanceProxy convex, cloud;
+		convex.SetConvex(points, count, 0.0f);
+		cloud.Set(points, count, 0.0f);
+		CHECK(convex.m_convex);
+		CHECK(cloud.m_convex == false);
+
+		for (int32 k = 0; k < 4 * count; ++k)
+		{
+			float angle = 2.0f * b2_pi * float(k) / float(4 * count);
+			b2Vec2 d(cosf(angle), sinf(angle));
+			float expected = b2Dot(cloud.GetSupportVertex(d), d);
+			for (int32 start = 0; start < count; ++start)
+			{
+				CHECK(b2Dot(convex.GetVertex(convex.GetSupport(d, start)), d) == expected);
+			}
+		}
+
+		// Polygon shapes make convex proxies.
+		b2PolygonShape box;
+		box.SetAsBox(1.0f, 0.5f);
+		b2DistanceProxy boxProxy;
+		boxProxy.Set(&box, 0);
+		CHECK(boxProxy.m_convex);
+	}
+
+#if b2_maxPolygonVertices > b2_hillClimbVertexCount
+	SUBCASE("large polygons")
+	{
+		// The hill climbing collider must agree with the general one.
+		b2Vec2 points[b2_maxPolygonVertices];
+		const int32 counts[4] = { 4, 12, 20, 32 };
+		b2PolygonShape polygons[4];
+		for (int32 i = 0; i < 4; ++i)
+		{
+			for (int32 j = 0; j < counts[i]; ++j)
+			{
+				float angle = 2.0f * b2_pi * float(j) / float(counts[i]) + 0.1f * i;
+				points[j].Set(cosf(angle), 0.6f * sinf(angle));
+			}
+
+			polygons[i].Set(points, counts[i]);
+			REQUIRE(polygons[i].m_count == counts[i]);
+		}
+
+		int32 touchingCount = 0;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			for (int32 j = 0; j < 4; ++j)
+			{
+				for (int32 k = 0; k < 32; ++k)
+				{
+					b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.2f * i));
+					b2Transform xfB(b2Vec2(-1.6f + 0.1f * k, 0.5f * sinf(0.4f * k)), b2Rot(0.13f * k + 0.4f * j));
+
+					b2Manifold manifold1, manifold2;
+					b2_hillClimbCollision = true;
+					b2CollidePolygons(&manifold1, polygons + i, xfA, polygons + j, xfB);
+					b2_hillClimbCollision = false;
+					b2CollidePolygons(&manifold2, polygons + i, xfA, polygons + j, xfB);
+					b2_hillClimbCollision = true;
+
+					REQUIRE(manifold1.pointCount == manifold2.pointCount);
+					if (manifold1.pointCount == 0)
+					{
+						continue;
+					}
+
+					++touchingCount;
+					CHECK(manifold1.type == manifold2.type);
+					CHECK(b2Distance(manifold1.localNormal, manifold2.localNormal) < b2_linearSlop);
+					for (int32 p = 0; p < manifold1.pointCount; ++p)
+					{
+						CHECK(b2Distance(manifold1.points[p].localPoint, manifold2.points[p].localPoint) < b2_linearSlop);
+						CHECK(manifold1.points[p].id.key == manifold2.points[p].id.key);
+					}
+				}
+			}
+		}
+
+		CHECK(touchingCount > 100);
+
+		// Capsules collide as two sided segments, whose normals turn by half a turn.
+		b2CapsuleShape capsule;
+		capsule.Set(b2Vec2(-0.5f, 0.0f), b2Vec2(0.5f, 0.0f), 0.25f);
+		for (int32 k = 0; k < 64; ++k)
+		{
+			b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.05f * k));
+			b2Transform xfB(b2Vec2(1.2f * cosf(0.1f * k), 0.8f * sinf(0.1f * k)), b2Rot(0.5f * b2_pi * (k % 4)));
+
+			b2Manifold manifold1, manifold2;
+			b2_hillClimbCollision = true;
+			b2CollidePolygonAndCapsule(&manifold1, polygons + 3, xfA, &capsule, xfB);
+			b2_hillClimbCollision = false;
+			b2CollidePolygonAndCapsule(&manifold2, polygons + 3, xfA, &capsule, xfB);
+			b2_hillClimbCollision = true;
+
+			REQUIRE(manifold1.pointCount == manifold2.pointCount);
+			for (int32 p = 0; p < manifold1.pointCount; ++p)
+			{
+				CHECK(b2Distance(manifold1.points[p].localPoint, manifold2.points[p].localPoint) < b2_linearSlop);
+			}
+		}
+	}
+#endif
+
+	SUBCASE("chain segment collider")
+	{
+		// A bumpy chain with convex and concave corners.
+		b2Vec2 vertices[12];
+		for (int32 i = 0; i < 12; ++i)
+		{
+			vertices[i].Set(6.0f - 1.0f * i, 0.4f * sinf(1.3f * i));
+		}
+
+		b2ChainShape chain;
+		chain.CreateChain(vertices, 12, b2Vec2(7.0f, 0.5f), b2Vec2(-6.0f, -0.5f));
+		REQUIRE(chain.m_normals != nullptr);
+		for (int32 i = 0; i <= chain.m_count; ++i)
+		{
+			CHECK(chain.m_normals[i].Length() == doctest::Approx(1.0f));
+		}
+
+		const int32 count = b2_maxPolygonVertices;
+		b2Vec2 points[count];
+		for (int32 j = 0; j < count; ++j)
+		{
+			float angle = 2.0f * b2_pi * float(j) / float(count);
+			points[j].Set(0.5f * cosf(angle), 0.3f * sinf(angle));
+		}
+
+		b2PolygonShape polygons[4];
+		polygons[0].SetAsBox(0.4f, 0.3f);
+		polygons[1].Set(points, 3);
+		polygons[2].Set(points, 7);
+		polygons[3].Set(points, count);
+
+		b2Transform xfA(b2Vec2(0.2f, -0.1f), b2Rot(0.05f));
+
+		// The stored normals and the SIMD kernel must agree exactly with the edge collider.
+		int32 touchingCount = 0;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			for (int32 index = 0; index < chain.GetChildCount(); ++index)
+			{
+				b2EdgeShape edge;
+				chain.GetChildEdge(&edge, index);
+
+				for (int32 k = 0; k < 16; ++k)
+				{
+					b2Vec2 center = 0.5f * (edge.m_vertex1 + edge.m_vertex2);
+					b2Transform xfB(b2Mul(xfA, center + b2Vec2(0.1f * (k - 8), 0.05f * k - 0.3f)), b2Rot(0.4f * k));
+
+					b2Manifold manifolds[3];
+					b2_simdCollision = true;
+					b2CollideChainAndPolygon(manifolds + 0, &chain, index, xfA, polygons + i, xfB);
+					b2CollideEdgeAndPolygon(manifolds + 1, &edge, xfA, polygons + i, xfB);
+					b2_simdCollision = false;
+					b2CollideChainAndPolygon(manifolds + 2, &chain, index, xfA, polygons + i, xfB);
+					b2_simdCollision = true;
+
+					touchingCount += manifolds[0].pointCount > 0 ? 1 : 0;
+					for (int32 m = 1; m < 3; ++m)
+					{
+						REQUIRE(manifolds[m].pointCount == manifolds[0].pointCount);
+						if (manifolds[0].pointCount == 0)
+						{
+							continue;
+						}
+
+						CHECK(manifolds[m].type == manifolds[0].type);
+						CHECK(manifolds[m].localNormal == manifolds[0].localNormal);
+						CHECK(manifolds[m].localPoint == manifolds[0].localPoint);
+						for (int32 p = 0; p < manifolds[0].pointCount; ++p)
+						{
+							CHECK(manifolds[m].points[p].localPoint == manifolds[0].points[p].localPoint);
+							CHECK(manifolds[m].points[p].id.key == manifolds[0].points[p].id.key);
+						}
+					}
+				}
+			}
+		}
+
+		CHECK(touchingCount > 100);
+	}
+
+	SUBCASE("warm started overlap")
+	{
+		// A persistent simplex cache must not change the answer of the overlap test.
+		b2PolygonShape box;
+		box.SetAsBox(1.0f, 0.5f);
+
+		b2CircleShape circle;
+		circle.m_radius = 0.5f;
+
+		const b2Shape* shapes[2] = { &box, &circle };
+		for (int32 i = 0; i < 2; ++i)
+		{
+			b2SimplexCache cache;
+			cache.count = 0;
+
+			int32 overlapCount = 0;
+			for (int32 k = 0; k < 200; ++k)
+			{
+				b2Transform xfA(b2Vec2(0.0f, 0.0f), b2Rot(0.0f));
+				b2Transform xfB(b2Vec2(-3.0f + 0.03f * k, 0.4f * sinf(0.05f * k)), b2Rot(0.02f * k));
+
+				bool cold = b2TestOverlap(&box, 0, shapes[i], 0, xfA, xfB);
+				bool warm = b2TestOverlap(&box, 0, shapes[i], 0, xfA, xfB, &cache);
+				CHECK(warm == cold);
+				overlapCount += warm ? 1 : 0;
+			}
+
+			CHECK(overlapCount > 0);
+			CHECK(overlapCount < 200);
+		}
+	}
 }
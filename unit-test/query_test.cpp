@@ -0,0 +1,712 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/box2d.h"
+#include "box2d/b2_distance.h"
+#include "doctest.h"
+#include <stdio.h>
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// A field of small shapes for exercising world queries.
+void CreateQueryScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-50.0f, 0.0f), b2Vec2(50.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.4f;
+
+	b2PolygonShape box;
+	box.SetAsBox(0.4f, 0.3f);
+
+	b2BodyDef bodyDef;
+	bodyDef.type = b2_dynamicBody;
+	for (int32 i = 0; i < 20; ++i)
+	{
+		for (int32 j = 0; j < 10; ++j)
+		{
+			bodyDef.position.Set(-40.0f + 4.0f * i + 0.3f * j, 1.0f + 2.0f * j);
+			bodyDef.angle = 0.1f * i;
+			b2Body* body = world->CreateBody(&bodyDef);
+			if ((i + j) % 2 == 0)
+			{
+				body->CreateFixture(&circle, 1.0f);
+			}
+			else
+			{
+				body->CreateFixture(&box, 1.0f);
+			}
+		}
+	}
+}
+
+typedef std::multiset<std::pair<int32, b2Fixture*>> HitSet;
+
+class QueryCollector : public b2QueryCallback
+{
+public:
+	bool ReportFixture(b2Fixture* fixture) override
+	{
+		hits.insert(std::make_pair(queryIndex, fixture));
+		return true;
+	}
+
+	int32 queryIndex = 0;
+	HitSet hits;
+};
+
+class ClosestRayCallback : public b2RayCastCallback
+{
+public:
+	float ReportFixture(b2Fixture* fixture, const b2Vec2&, const b2Vec2&, float fraction) override
+	{
+		this->fixture = fixture;
+		this->fraction = fraction;
+		return fraction;
+	}
+
+	b2Fixture* fixture = nullptr;
+	float fraction = 1.0f;
+};
+
+// Run a fixed mix of read-only queries and summarize the results.
+void RunQueries(const b2World* world, std::vector<int32>* results)
+{
+	b2CircleShape probe;
+	probe.m_radius = 1.0f;
+
+	const int32 queryCount = 50;
+	b2AABB aabbs[queryCount];
+	b2RayCastInput inputs[queryCount];
+
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		b2Vec2 center(-40.0f + 1.6f * i, 2.0f + 0.3f * i);
+		aabbs[i].lowerBound = center - b2Vec2(1.0f, 1.0f);
+		aabbs[i].upperBound = center + b2Vec2(1.0f, 1.0f);
+
+		QueryCollector query;
+		world->QueryAABB(&query, aabbs[i]);
+
+		// Exact overlap tests against the candidates.
+		b2Transform probeTransform(center, b2Rot(0.0f));
+		int32 overlapCount = 0;
+		for (HitSet::const_iterator it = query.hits.begin(); it != query.hits.end(); ++it)
+		{
+			const b2Fixture* fixture = it->second;
+			if (b2TestOverlap(&probe, 0, fixture->GetShape(), 0, probeTransform, fixture->GetBody()->GetTransform()))
+			{
+				++overlapCount;
+			}
+		}
+
+		inputs[i].p1 = center;
+		inputs[i].p2 = center + b2Vec2(0.0f, -30.0f);
+		inputs[i].maxFraction = 1.0f;
+
+		ClosestRayCallback ray;
+		world->RayCast(&ray, inputs[i].p1, inputs[i].p2);
+
+		results->push_back(int32(query.hits.size()));
+		results->push_back(overlapCount);
+		results->push_back(ray.fixture != nullptr ? int32(1000.0f * ray.fraction) : -1);
+	}
+
+	b2QueryHit hits[256];
+	results->push_back(world->QueryAABBBatch(aabbs, queryCount, hits, 256));
+
+	b2RayCastHit rayHits[queryCount];
+	world->RayCastBatch(inputs, rayHits, queryCount);
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		results->push_back(rayHits[i].fixture != nullptr ? int32(1000.0f * rayHits[i].fraction) : -1);
+	}
+}
+
+}
+
+DOCTEST_TEST_CASE("world query test")
+{
+	SUBCASE("batched AABB query")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		const int32 queryCount = 300;
+		std::vector<b2AABB> aabbs(queryCount);
+		for (int32 i = 0; i < queryCount; ++i)
+		{
+			float x = -45.0f + 0.3f * ((i * 37) % queryCount);
+			float y = -2.0f + 0.07f * ((i * 53) % queryCount);
+			aabbs[i].lowerBound.Set(x, y);
+			aabbs[i].upperBound.Set(x + 1.0f + 0.01f * i, y + 1.5f);
+		}
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			QueryCollector expected;
+			for (int32 i = 0; i < queryCount; ++i)
+			{
+				expected.queryIndex = i;
+				world.QueryAABB(&expected, aabbs[i]);
+			}
+
+			std::vector<b2QueryHit> hits(4096);
+			int32 hitCount = world.QueryAABBBatch(aabbs.data(), queryCount, hits.data(), int32(hits.size()));
+			REQUIRE(hitCount <= int32(hits.size()));
+
+			HitSet actual;
+			for (int32 i = 0; i < hitCount; ++i)
+			{
+				actual.insert(std::make_pair(hits[i].queryIndex, hits[i].fixture));
+			}
+
+			CHECK(expected.hits.size() > 0);
+			CHECK(actual == expected.hits);
+
+			// A small buffer reports the full count.
+			b2QueryHit smallHits[8];
+			CHECK(world.QueryAABBBatch(aabbs.data(), queryCount, smallHits, 8) == hitCount);
+		}
+	}
+
+	SUBCASE("batched ray cast")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		// A fan of rays from a few sensor positions.
+		const int32 rayCount = 257;
+		std::vector<b2RayCastInput> inputs(rayCount);
+		for (int32 i = 0; i < rayCount; ++i)
+		{
+			float angle = 0.05f * i;
+			inputs[i].p1.Set(-30.0f + 10.0f * (i / 64), 8.0f);
+			inputs[i].p2 = inputs[i].p1 + 30.0f * b2Vec2(cosf(angle), sinf(angle));
+			inputs[i].maxFraction = i % 5 == 0 ? 0.5f : 1.0f;
+		}
+
+		// A vertical ray exercises a zero direction component.
+		inputs[3].p2.Set(inputs[3].p1.x, -10.0f);
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			std::vector<b2RayCastHit> hits(rayCount);
+			world.RayCastBatch(inputs.data(), hits.data(), rayCount);
+
+			int32 hitCount = 0;
+			for (int32 i = 0; i < rayCount; ++i)
+			{
+				ClosestRayCallback callback;
+				b2Vec2 p2 = inputs[i].p1 + inputs[i].maxFraction * (inputs[i].p2 - inputs[i].p1);
+				world.RayCast(&callback, inputs[i].p1, p2);
+
+				CHECK(hits[i].fixture == callback.fixture);
+				if (callback.fixture != nullptr)
+				{
+					++hitCount;
+					CHECK(hits[i].fraction == doctest::Approx(callback.fraction * inputs[i].maxFraction));
+				}
+			}
+
+			CHECK(hitCount > rayCount / 4);
+		}
+	}
+
+	SUBCASE("concurrent queries")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		// Settle the bodies a little so that some shapes touch.
+		for (int32 i = 0; i < 10; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			std::vector<int32> expected;
+			RunQueries(&world, &expected);
+
+			// Queries may run on many threads while the world is not being modified.
+			const int32 threadCount = 4;
+			std::vector<int32> results[threadCount];
+			std::vector<std::thread> threads;
+			for (int32 i = 0; i < threadCount; ++i)
+			{
+				threads.push_back(std::thread(RunQueries, &world, results + i));
+			}
+
+			for (int32 i = 0; i < threadCount; ++i)
+			{
+				threads[i].join();
+				CHECK(results[i] == expected);
+			}
+		}
+	}
+
+	SUBCASE("filtered query")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		// Put circles and boxes in different categories after creation.
+		for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+		{
+			for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+			{
+				b2Filter filter;
+				filter.categoryBits = fixture->GetType() == b2Shape::e_circle ? 0x0002 : 0x0004;
+				fixture->SetFilterData(filter);
+			}
+		}
+
+		b2Filter circleFilter;
+		circleFilter.maskBits = 0x0002;
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(-20.0f, 0.0f);
+		aabb.upperBound.Set(10.0f, 12.0f);
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			QueryCollector all;
+			world.QueryAABB(&all, aabb);
+
+			HitSet expected;
+			for (HitSet::const_iterator it = all.hits.begin(); it != all.hits.end(); ++it)
+			{
+				if (it->second->GetType() == b2Shape::e_circle)
+				{
+					expected.insert(*it);
+				}
+			}
+
+			QueryCollector filtered;
+			world.QueryAABB(&filtered, aabb, circleFilter);
+
+			CHECK(expected.size() > 0);
+			CHECK(expected.size() < all.hits.size());
+			CHECK(filtered.hits == expected);
+
+			// The ray passes through boxes before reaching a circle.
+			for (int32 i = 0; i < 10; ++i)
+			{
+				b2Vec2 p1(-41.0f, 1.0f + 2.0f * i);
+				b2Vec2 p2(41.0f, 1.0f + 2.0f * i);
+
+				ClosestRayCallback ray;
+				world.RayCast(&ray, p1, p2, circleFilter);
+				REQUIRE(ray.fixture != nullptr);
+				CHECK(ray.fixture->GetType() == b2Shape::e_circle);
+			}
+		}
+	}
+
+	SUBCASE("callable query")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(-20.0f, 0.0f);
+		aabb.upperBound.Set(10.0f, 12.0f);
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			QueryCollector expected;
+			world.QueryAABB(&expected, aabb);
+
+			HitSet hits;
+			world.QueryAABB(aabb, [&hits](b2Fixture* fixture)
+			{
+				hits.insert(std::make_pair(0, fixture));
+				return true;
+			});
+
+			CHECK(hits.size() > 0);
+			CHECK(hits == expected.hits);
+
+			// Returning false terminates the query.
+			int32 count = 0;
+			world.QueryAABB(aabb, [&count](b2Fixture*)
+			{
+				++count;
+				return false;
+			});
+			CHECK(count == 1);
+
+			int32 hitCount = 0;
+			for (int32 i = 0; i < 20; ++i)
+			{
+				b2Vec2 p1(-41.0f + 4.0f * i, 30.0f);
+				b2Vec2 p2(-35.0f + 4.0f * i, -10.0f);
+
+				ClosestRayCallback callback;
+				world.RayCast(&callback, p1, p2);
+
+				b2Fixture* closest = nullptr;
+				float closestFraction = 1.0f;
+				world.RayCast(p1, p2, [&](b2Fixture* fixture, const b2Vec2&, const b2Vec2&, float fraction)
+				{
+					closest = fixture;
+					closestFraction = fraction;
+					return fraction;
+				});
+				CHECK(closest == callback.fixture);
+
+				b2RayCastHit hit;
+				bool closestHit = world.RayCastClosest(p1, p2, &hit);
+				bool anyHit = world.RayCastAny(p1, p2, nullptr);
+				CHECK(closestHit == (callback.fixture != nullptr));
+				CHECK(anyHit == closestHit);
+
+				if (closestHit)
+				{
+					++hitCount;
+					CHECK(hit.fixture == callback.fixture);
+					CHECK(hit.fraction == doctest::Approx(callback.fraction));
+					CHECK(closestFraction == doctest::Approx(callback.fraction));
+
+					b2RayCastHit anyResult;
+					world.RayCastAny(p1, p2, &anyResult);
+					CHECK(anyResult.fraction >= hit.fraction);
+				}
+			}
+
+			CHECK(hitCount > 10);
+		}
+	}
+
+	SUBCASE("shape cast")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		b2PolygonShape square;
+		square.SetAsBox(0.5f, 0.5f);
+
+		const int32 sweepCount = 24;
+		b2ShapeCastQuery queries[sweepCount];
+		for (int32 i = 0; i < sweepCount; ++i)
+		{
+			queries[i].shape = &square;
+			queries[i].transform.Set(b2Vec2(-45.0f + 3.7f * i, 30.0f), 0.2f * i);
+			queries[i].translation.Set(1.0f, -35.0f);
+		}
+
+		// This sweep passes above the scene.
+		queries[5].transform.p.Set(0.0f, 60.0f);
+		queries[5].translation.Set(10.0f, 0.0f);
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			b2RayCastHit hits[sweepCount];
+			world.ShapeCastBatch(queries, hits, sweepCount);
+
+			int32 hitCount = 0;
+			for (int32 i = 0; i < sweepCount; ++i)
+			{
+				// Brute force against every fixture.
+				b2Fixture* expected = nullptr;
+				float expectedFraction = 1.0f;
+				for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+				{
+					for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+					{
+						b2ShapeCastInput input;
+						input.proxyA.Set(fixture->GetShape(), 0);
+						input.proxyB.Set(&square, 0);
+						input.transformA = body->GetTransform();
+						input.transformB = queries[i].transform;
+						input.translationB = queries[i].translation;
+
+						b2ShapeCastOutput output;
+						if (b2ShapeCast(&output, &input) && output.lambda < expectedFraction)
+						{
+							expected = fixture;
+							expectedFraction = output.lambda;
+						}
+					}
+				}
+
+				CHECK(hits[i].fixture == expected);
+				if (expected != nullptr)
+				{
+					++hitCount;
+					CHECK(hits[i].fraction == doctest::Approx(expectedFraction).epsilon(0.001));
+
+					b2RayCastHit hit;
+					CHECK(world.ShapeCast(queries[i].shape, queries[i].transform, queries[i].translation, &hit));
+					CHECK(hit.fixture == expected);
+					CHECK(hit.normal.y > 0.0f);
+				}
+			}
+
+			CHECK(hits[5].fixture == nullptr);
+			CHECK(hitCount > sweepCount / 2);
+		}
+	}
+
+	SUBCASE("shape overlap")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		b2PolygonShape triangle;
+		b2Vec2 vertices[3] = { b2Vec2(-3.0f, -2.0f), b2Vec2(3.0f, -2.0f), b2Vec2(0.0f, 3.0f) };
+		triangle.Set(vertices, 3);
+
+		b2Filter filter;
+		b2OverlapCache cache;
+
+		const int32 queryCount = 8;
+		b2ShapeQuery queries[queryCount];
+		for (int32 i = 0; i < queryCount; ++i)
+		{
+			queries[i].shape = &triangle;
+			queries[i].transform.Set(b2Vec2(-35.0f + 10.0f * i, 2.0f + 2.0f * i), 0.3f * i);
+		}
+
+		// The cached query is repeated while the bodies fall.
+		for (int32 step = 0; step < 30; ++step)
+		{
+			b2AABB aabb;
+			triangle.ComputeAABB(&aabb, queries[0].transform, 0);
+
+			QueryCollector candidates;
+			world.QueryAABB(&candidates, aabb);
+
+			HitSet expected;
+			for (HitSet::const_iterator it = candidates.hits.begin(); it != candidates.hits.end(); ++it)
+			{
+				b2Fixture* fixture = it->second;
+				if (b2TestOverlap(fixture->GetShape(), 0, &triangle, 0, fixture->GetBody()->GetTransform(), queries[0].transform))
+				{
+					expected.insert(*it);
+				}
+			}
+
+			QueryCollector overlaps;
+			world.OverlapShape(&overlaps, &triangle, queries[0].transform);
+			CHECK(overlaps.hits == expected);
+
+			QueryCollector cached;
+			world.OverlapShape(&cached, &triangle, queries[0].transform, filter, &cache);
+			CHECK(cached.hits == expected);
+
+			if (step == 0)
+			{
+				CHECK(expected.size() > 0);
+				CHECK(expected.size() < candidates.hits.size());
+			}
+
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		int32 expectedCount = 0;
+		for (int32 i = 0; i < queryCount; ++i)
+		{
+			QueryCollector overlaps;
+			world.OverlapShape(&overlaps, queries[i].shape, queries[i].transform);
+			expectedCount += int32(overlaps.hits.size());
+		}
+
+		b2QueryHit hits[256];
+		CHECK(expectedCount > 0);
+		CHECK(world.OverlapShapeBatch(queries, queryCount, filter, hits, 256) == expectedCount);
+
+		// A filter that matches nothing.
+		filter.maskBits = 0;
+		CHECK(world.OverlapShapeBatch(queries, queryCount, filter, hits, 256) == 0);
+	}
+
+	SUBCASE("nearest query")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateQueryScene(&world);
+
+		b2Filter filter;
+
+		for (int32 type = b2_dynamicTreeBroadPhase; type <= b2_gridBroadPhase; ++type)
+		{
+			world.SetBroadPhaseType(b2BroadPhaseType(type));
+
+			for (int32 i = 0; i < 12; ++i)
+			{
+				b2Vec2 point(-45.0f + 8.3f * i, 3.0f + 1.7f * i);
+
+				// Brute force distances to every fixture.
+				std::vector<float> distances;
+				for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+				{
+					for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+					{
+						b2DistanceInput input;
+						input.proxyA.Set(fixture->GetShape(), 0);
+						input.proxyB.Set(&point, 1, 0.0f);
+						input.transformA = body->GetTransform();
+						input.transformB.SetIdentity();
+						input.useRadii = true;
+
+						b2SimplexCache cache;
+						cache.count = 0;
+						b2DistanceOutput output;
+						b2Distance(&output, &cache, &input);
+						distances.push_back(output.distance);
+					}
+				}
+
+				std::sort(distances.begin(), distances.end());
+
+				b2NearestHit hit;
+				REQUIRE(world.NearestFixture(point, b2_maxFloat, &hit));
+				CHECK(hit.distance == doctest::Approx(distances[0]));
+				CHECK(b2Distance(hit.point, point) == doctest::Approx(hit.distance).epsilon(0.001));
+
+				const int32 k = 5;
+				b2NearestHit hits[k];
+				REQUIRE(world.NearestFixtures(point, b2_maxFloat, filter, hits, k) == k);
+				for (int32 j = 0; j < k; ++j)
+				{
+					CHECK(hits[j].distance == doctest::Approx(distances[j]));
+				}
+
+				// The cutoff keeps only the fixtures within the distance.
+				float cutoff = 0.5f * (distances[1] + distances[2]);
+				CHECK(world.NearestFixtures(point, cutoff, filter, hits, k) == 2);
+				CHECK(world.NearestFixture(point, 0.5f * distances[0], &hit) == false);
+			}
+		}
+
+		// A filter that matches nothing.
+		filter.maskBits = 0;
+		b2NearestHit hits[4];
+		CHECK(world.NearestFixtures(b2Vec2_zero, b2_maxFloat, filter, hits, 4) == 0);
+	}
+
+	SUBCASE("persistent query")
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+
+		// Static boxes inside the query AABB.
+		b2BodyDef bodyDef;
+		for (int32 i = 0; i < 5; ++i)
+		{
+			bodyDef.position.Set(2.0f * i, 0.0f);
+			world.CreateBody(&bodyDef)->CreateFixture(&box, 0.0f);
+		}
+
+		// A falling body far away.
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(100.0f, 50.0f);
+		b2Body* faller = world.CreateBody(&bodyDef);
+		faller->CreateFixture(&box, 1.0f);
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(-1.0f, -1.0f);
+		aabb.upperBound.Set(5.0f, 1.0f);
+
+		b2PersistentQuery* query = world.CreatePersistentQuery(aabb);
+		b2PersistentQuery* other = world.CreatePersistentQuery(aabb);
+		CHECK(world.GetPersistentQueryList() == other);
+		CHECK(query->IsValid() == false);
+		CHECK(query->Update() == 3);
+		CHECK(query->IsValid());
+
+		// Motion far away does not invalidate the query.
+		for (int32 i = 0; i < 10; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		CHECK(query->IsValid());
+
+		// A body created inside the AABB is found without a step.
+		bodyDef.position.Set(1.0f, 0.5f);
+		b2Body* body = world.CreateBody(&bodyDef);
+		b2Fixture* fixture = body->CreateFixture(&box, 1.0f);
+		CHECK(query->Update() == 4);
+
+		bool found = false;
+		for (int32 i = 0; i < query->GetFixtureCount(); ++i)
+		{
+			found = found || query->GetFixture(i) == fixture;
+		}
+		CHECK(found);
+
+		// Moving the body away is detected by the step.
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(query->Update() == 4);
+		body->SetTransform(b2Vec2(-50.0f, 0.0f), 0.0f);
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(query->IsValid() == false);
+		CHECK(query->Update() == 3);
+
+		// Destroying a fixture that was found invalidates the query.
+		b2Fixture* first = query->GetFixture(0);
+		first->GetBody()->DestroyFixture(first);
+		CHECK(query->IsValid() == false);
+		CHECK(query->Update() == 2);
+
+		// The result matches a plain query.
+		QueryCollector expected;
+		world.QueryAABB(&expected, aabb);
+		CHECK(int32(expected.hits.size()) == 2);
+
+		world.SetBroadPhaseType(b2_gridBroadPhase);
+		CHECK(query->Update() == 2);
+
+		query->SetAABB(b2AABB{ b2Vec2(-2.0f, -2.0f), b2Vec2(10.0f, 2.0f) });
+		CHECK(query->Update() == 4);
+
+		world.DestroyPersistentQuery(other);
+		CHECK(world.GetPersistentQueryList() == query);
+		CHECK(query->GetNext() == nullptr);
+	}
+}
@@ -71,3 +71,427 @@ DOCTEST_TEST_CASE("begin contact")
 	CHECK(world.GetContactList() != nullptr);
 	CHECK(begin_contact == true);
 }
+
+DOCTEST_TEST_CASE("manifold reuse")
+{
+	b2World world = b2World(b2Vec2(0.0f, -10.0f));
+	world.SetAllowSleeping(false);
+
+	b2BodyDef bodyDef;
+	b2Body* ground = world.CreateBody(&bodyDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-10.0f, 0.0f), b2Vec2(10.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	bodyDef.type = b2_dynamicBody;
+	b2Body* bodies[3];
+	for (int32 i = 0; i < 3; ++i)
+	{
+		bodyDef.position.Set(0.0f, 0.5f + 1.0f * i);
+		bodies[i] = world.CreateBody(&bodyDef);
+		bodies[i]->CreateFixture(&box, 1.0f);
+	}
+
+	const float timeStep = 1.0f / 60.0f;
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world.Step(timeStep, 8, 3);
+	}
+
+	float heights[3];
+	for (int32 i = 0; i < 3; ++i)
+	{
+		heights[i] = bodies[i]->GetPosition().y;
+	}
+
+	// Manifold reuse is off by default.
+	CHECK(world.GetManifoldReuse() == false);
+	CHECK(world.GetReusedManifoldCount() == 0);
+
+	world.SetManifoldReuse(true);
+	world.Step(timeStep, 8, 3);
+	world.Step(timeStep, 8, 3);
+
+	// The resting stack reuses all its manifolds and stays put.
+	CHECK(world.GetReusedManifoldCount() == world.GetContactCount());
+	for (int32 i = 0; i < 3; ++i)
+	{
+		CHECK(bodies[i]->GetPosition().y == doctest::Approx(heights[i]).epsilon(0.001f));
+		CHECK(bodies[i]->GetContactList()->contact->GetManifold()->pointCount == 2);
+	}
+
+	// A body that moves computes fresh manifolds. Collision runs before the
+	// solver, so the motion shows up in the second step.
+	bodies[2]->SetLinearVelocity(b2Vec2(1.0f, 0.0f));
+	world.Step(timeStep, 8, 3);
+	world.Step(timeStep, 8, 3);
+	CHECK(world.GetReusedManifoldCount() == world.GetContactCount() - 1);
+}
+
+static int32 begin_contact_count = 0;
+
+class CountingContactListener : public b2ContactListener
+{
+public:
+	void BeginContact(b2Contact* contact)
+	{
+		B2_NOT_USED(contact);
+		++begin_contact_count;
+	}
+};
+
+DOCTEST_TEST_CASE("batched narrow phase")
+{
+	b2World world = b2World(b2Vec2(0.0f, -10.0f));
+	CountingContactListener listener;
+	world.SetContactListener(&listener);
+
+	b2BodyDef bodyDef;
+	b2Body* ground = world.CreateBody(&bodyDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-600.0f, 0.0f), b2Vec2(600.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2CapsuleShape capsule;
+	capsule.Set(b2Vec2(-0.25f, 0.0f), b2Vec2(0.25f, 0.0f), 0.5f);
+
+	// More contacts than fit in one batch, with the shape types interleaved.
+	const int32 count = 2 * b2_contactBatchSize;
+	b2Transform transforms[count];
+	bodyDef.type = b2_dynamicBody;
+	for (int32 i = 0; i < count; ++i)
+	{
+		bodyDef.position.Set(-2.0f * b2_contactBatchSize + 2.0f * i, 0.49f);
+		bodyDef.angle = 0.001f * i;
+		b2Body* body = world.CreateBody(&bodyDef);
+		body->GetUserData().pointer = uintptr_t(i);
+		transforms[i] = body->GetTransform();
+
+		switch (i % 3)
+		{
+		case 0:
+			body->CreateFixture(&circle, 1.0f);
+			break;
+		case 1:
+			body->CreateFixture(&box, 1.0f);
+			break;
+		default:
+			body->CreateFixture(&capsule, 1.0f);
+			break;
+		}
+	}
+
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	CHECK(world.GetContactCount() == count);
+	CHECK(begin_contact_count == count);
+
+	// Each contact got the manifold of its own shapes at the transforms before the step.
+	for (b2Contact* c = world.GetContactList(); c; c = c->GetNext())
+	{
+		b2Body* bodyA = c->GetFixtureA()->GetBody();
+		b2Body* bodyB = c->GetFixtureB()->GetBody();
+		b2Transform xfA = bodyA == ground ? ground->GetTransform() : transforms[bodyA->GetUserData().pointer];
+		b2Transform xfB = bodyB == ground ? ground->GetTransform() : transforms[bodyB->GetUserData().pointer];
+
+		b2Manifold manifold;
+		c->Evaluate(&manifold, xfA, xfB);
+
+		const b2Manifold* cached = c->GetManifold();
+		CHECK(c->IsTouching());
+		REQUIRE(cached->pointCount == manifold.pointCount);
+		CHECK(cached->type == manifold.type);
+		CHECK(cached->localNormal.x == manifold.localNormal.x);
+		CHECK(cached->localNormal.y == manifold.localNormal.y);
+		for (int32 i = 0; i < manifold.pointCount; ++i)
+		{
+			CHECK(cached->points[i].id.key == manifold.points[i].id.key);
+			CHECK(cached->points[i].localPoint.x == manifold.points[i].localPoint.x);
+			CHECK(cached->points[i].localPoint.y == manifold.points[i].localPoint.y);
+		}
+	}
+}
+
+static float fire_at_wall(bool speculative, const b2Shape* shape)
+{
+	b2World world = b2World(b2Vec2(0.0f, -10.0f));
+	world.SetContinuousPhysics(false);
+	world.SetSpeculativeContacts(speculative);
+
+	b2BodyDef bodyDef;
+	b2Body* ground = world.CreateBody(&bodyDef);
+
+	b2EdgeShape floor;
+	floor.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	ground->CreateFixture(&floor, 0.0f);
+
+	b2PolygonShape wall;
+	wall.SetAsBox(0.05f, 5.0f, b2Vec2(10.0f, 5.0f), 0.0f);
+	ground->CreateFixture(&wall, 0.0f);
+
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position.Set(0.0f, 1.0f);
+	bodyDef.linearVelocity.Set(300.0f, 0.0f);
+	b2Body* body = world.CreateBody(&bodyDef);
+	body->CreateFixture(shape, 1.0f);
+
+	float maxX = body->GetPosition().x;
+	for (int32 i = 0; i < 60; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		maxX = b2Max(maxX, body->GetPosition().x);
+	}
+
+	return maxX;
+}
+
+static float bounce_speed(bool speculative, float speed)
+{
+	b2World world = b2World(b2Vec2_zero);
+	world.SetSpeculativeContacts(speculative);
+
+	b2BodyDef bodyDef;
+	b2Body* ground = world.CreateBody(&bodyDef);
+
+	b2PolygonShape floor;
+	floor.SetAsBox(20.0f, 0.5f, b2Vec2(0.0f, -0.5f), 0.0f);
+	ground->CreateFixture(&floor, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.2f;
+
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position.Set(0.0f, 2.0f);
+	bodyDef.linearVelocity.Set(0.0f, -speed);
+	b2Body* body = world.CreateBody(&bodyDef);
+
+	b2FixtureDef fixtureDef;
+	fixtureDef.shape = &circle;
+	fixtureDef.density = 1.0f;
+	fixtureDef.restitution = 1.0f;
+	body->CreateFixture(&fixtureDef);
+
+	float maxUp = 0.0f;
+	for (int32 i = 0; i < 30; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		maxUp = b2Max(maxUp, body->GetLinearVelocity().y);
+	}
+
+	return maxUp;
+}
+
+DOCTEST_TEST_CASE("speculative contacts")
+{
+	b2CircleShape circle;
+	circle.m_radius = 0.2f;
+
+	b2PolygonShape box;
+	box.SetAsBox(0.2f, 0.2f);
+
+	SUBCASE("off by default")
+	{
+		b2World world = b2World(b2Vec2(0.0f, -10.0f));
+		CHECK(world.GetSpeculativeContacts() == false);
+	}
+
+	SUBCASE("static wall")
+	{
+		// Without time of impact a fast body ends up inside the thin wall.
+		CHECK(fire_at_wall(false, &circle) > 9.95f);
+
+		// Speculative contacts stop it at the surface.
+		CHECK(fire_at_wall(true, &circle) < 9.95f - 0.2f + b2_linearSlop);
+		CHECK(fire_at_wall(true, &box) < 9.95f - 0.2f + b2_linearSlop);
+	}
+
+	SUBCASE("restitution")
+	{
+		// Speculative points bounce like touching ones.
+		CHECK(bounce_speed(true, 10.0f) == doctest::Approx(10.0f).epsilon(0.05f));
+		CHECK(bounce_speed(true, 60.0f) == doctest::Approx(60.0f).epsilon(0.05f));
+		CHECK(bounce_speed(true, 60.0f) == doctest::Approx(bounce_speed(false, 60.0f)).epsilon(0.05f));
+	}
+
+	SUBCASE("manifold reuse")
+	{
+		b2World world = b2World(b2Vec2_zero);
+		world.SetSpeculativeContacts(true);
+		world.SetManifoldReuse(true);
+
+		b2BodyDef bodyDef;
+		b2Body* ground = world.CreateBody(&bodyDef);
+
+		b2PolygonShape wall;
+		wall.SetAsBox(0.05f, 2.0f, b2Vec2(0.2f, 0.0f), 0.0f);
+		ground->CreateFixture(&wall, 0.0f);
+
+		b2CircleShape ball;
+		ball.m_radius = 0.1f;
+
+		bodyDef.type = b2_dynamicBody;
+		b2Body* body = world.CreateBody(&bodyDef);
+		body->CreateFixture(&ball, 1.0f);
+
+		// At rest near the wall the empty manifold would be reused.
+		for (int32 i = 0; i < 5; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		body->SetLinearVelocity(b2Vec2(120.0f, 0.0f));
+		for (int32 i = 0; i < 30; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+			CHECK(body->GetPosition().x < 0.15f - 0.1f + b2_linearSlop);
+		}
+	}
+
+	SUBCASE("dynamic bodies")
+	{
+		b2World world = b2World(b2Vec2_zero);
+		world.SetContinuousPhysics(false);
+		world.SetSpeculativeContacts(true);
+
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(-5.0f, 0.0f);
+		bodyDef.linearVelocity.Set(300.0f, 0.0f);
+		b2Body* bodyA = world.CreateBody(&bodyDef);
+		bodyA->CreateFixture(&box, 1.0f);
+
+		bodyDef.position.Set(5.0f, 0.0f);
+		bodyDef.linearVelocity.Set(-300.0f, 0.0f);
+		b2Body* bodyB = world.CreateBody(&bodyDef);
+		bodyB->CreateFixture(&circle, 1.0f);
+
+		// The bodies must never swap sides.
+		for (int32 i = 0; i < 30; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+			CHECK(bodyB->GetPosition().x - bodyA->GetPosition().x > 0.4f - b2_linearSlop);
+		}
+	}
+}
+
+class SensorEventListener : public b2ContactListener
+{
+public:
+	void BeginContact(b2Contact* contact)
+	{
+		B2_NOT_USED(contact);
+		beginStep = step;
+		++beginCount;
+	}
+
+	void EndContact(b2Contact* contact)
+	{
+		B2_NOT_USED(contact);
+		endStep = step;
+		++endCount;
+	}
+
+	int32 step = 0;
+	int32 beginStep = -1;
+	int32 endStep = -1;
+	int32 beginCount = 0;
+	int32 endCount = 0;
+};
+
+DOCTEST_TEST_CASE("sensor simplex cache")
+{
+	b2World world = b2World(b2Vec2_zero);
+	SensorEventListener listener;
+	world.SetContactListener(&listener);
+
+	b2BodyDef bodyDef;
+	b2Body* ground = world.CreateBody(&bodyDef);
+
+	b2Vec2 vertices[8];
+	for (int32 i = 0; i < 8; ++i)
+	{
+		float angle = 2.0f * b2_pi * i / 8.0f;
+		vertices[i].Set(cosf(angle), sinf(angle));
+	}
+	b2PolygonShape octagon;
+	octagon.Set(vertices, 8);
+
+	b2FixtureDef fixtureDef;
+	fixtureDef.shape = &octagon;
+	fixtureDef.isSensor = true;
+	ground->CreateFixture(&fixtureDef);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.3f, 0.1f);
+
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position.Set(-3.0f, 0.2f);
+	bodyDef.linearVelocity.Set(4.0f, 0.0f);
+	bodyDef.angularVelocity = 3.0f;
+	b2Body* body = world.CreateBody(&bodyDef);
+	b2Fixture* fixture = body->CreateFixture(&box, 1.0f);
+
+	// Events fire at the steps where a cold overlap test changes its answer.
+	bool touching = false;
+	int32 expectedBeginStep = -1;
+	int32 expectedEndStep = -1;
+	int32 expectedBeginCount = 0;
+	int32 expectedEndCount = 0;
+	for (int32 i = 0; i < 90; ++i)
+	{
+		bool overlap = b2TestOverlap(&octagon, 0, &box, 0, ground->GetTransform(), body->GetTransform());
+		if (overlap && touching == false)
+		{
+			expectedBeginStep = i;
+			++expectedBeginCount;
+		}
+		else if (overlap == false && touching)
+		{
+			expectedEndStep = i;
+			++expectedEndCount;
+		}
+		touching = overlap;
+
+		listener.step = i;
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(expectedBeginCount == 1);
+	CHECK(expectedEndCount == 1);
+	CHECK(listener.beginCount == expectedBeginCount);
+	CHECK(listener.endCount == expectedEndCount);
+	CHECK(listener.beginStep == expectedBeginStep);
+	CHECK(listener.endStep == expectedEndStep);
+
+	// Park the body inside the sensor so the overlap test fills the cache.
+	body->SetTransform(b2Vec2(0.2f, 0.1f), 0.5f);
+	body->SetLinearVelocity(b2Vec2_zero);
+	body->SetAngularVelocity(0.0f);
+	world.Step(1.0f / 60.0f, 8, 3);
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	REQUIRE(body->GetContactList() != nullptr);
+	const b2Contact* contact = body->GetContactList()->contact;
+	CHECK(contact->IsTouching());
+	CHECK(contact->GetSimplexCache()->count > 0);
+
+	// With both bodies asleep the contact is not updated, so the reset stays visible.
+	body->SetAwake(false);
+	fixture->Refilter();
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	REQUIRE(body->GetContactList() != nullptr);
+	CHECK(body->GetContactList()->contact == contact);
+	CHECK(contact->GetSimplexCache()->count == 0);
+}